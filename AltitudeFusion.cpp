@@ -0,0 +1,172 @@
+/*
+ * AltitudeFusion.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See AltitudeFusion.h.
+ *
+ */
+
+#include "AltitudeFusion.h"
+
+// Longest step of the filter : a longer gap between two samples is cut
+#define DT_MAX_US 250000UL
+// dt in 1/65536 s = us * 4295 / 65536 (65536 * 65536 / 1e6 = 4294.97)
+#define US_TO_Q16 4295UL
+// GPS gain per 1024 us, Q24 : 2^24 * 1.024 / tau, tau in ms
+#define GPS_GAIN_Q24 ((17179869UL + ALT_FUSION_GPS_TAU_MS / 2) / ALT_FUSION_GPS_TAU_MS)
+
+// Barometric formula around the current altitude : d alt / d p0 =
+// 0.1903 * (4433000 cm - alt) / p0, with 0.1903 in Q10
+#define BARO_EXPONENT_Q10 195
+#define BARO_ALT_SCALE_CM 4433000L
+
+// Sea level pressure estimates outside of it are not weather
+#define SEA_LEVEL_PA_MIN 87000L
+#define SEA_LEVEL_PA_MAX 108500L
+
+/***************************************************
+* DATA
+***************************************************/
+static int32_t seaLevelPa = 101325;
+
+// Q8 : cm, cm/s, cm
+static int32_t height = 0;
+static int32_t speed = 0;
+static int32_t bias = 0;
+
+static int32_t lastBaroCm = 0;
+static uint32_t lastMicros = 0;
+static uint32_t gpsMicros = 0; // of the baro sample before the last GPS altitude
+static uint8_t started = 0;
+static uint8_t anchored = 0;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+/*
+ * value * q / 65536, rounded down, |value| * q under 2^46 : two 32 bits
+ * products instead of a 64 bits one.
+ */
+static int32_t mulQ16(int32_t value, uint16_t q) {
+    int32_t high = (value >> 16) * (int32_t)q;
+    uint32_t low = ((uint32_t)value & 0xFFFF) * q;
+    return high + (int32_t)(low >> 16);
+}
+
+static int32_t roundQ8(int32_t value) {
+    return (value + 128) >> 8;
+}
+
+void alt_fusion_begin(int32_t seaLevel) {
+    seaLevelPa = seaLevel;
+    height = 0;
+    speed = 0;
+    bias = 0;
+    started = 0;
+    anchored = 0;
+}
+
+void alt_fusion_baro(int32_t altitudeCm, uint32_t sampleMicros) {
+    uint32_t dt = sampleMicros - lastMicros;
+    uint16_t dtQ16;
+    int32_t error;
+
+    lastMicros = sampleMicros;
+    lastBaroCm = altitudeCm;
+    if (!started) {
+        height = (altitudeCm << 8) + bias;
+        speed = 0;
+        started = 1;
+        return;
+    }
+    if (dt > DT_MAX_US) {
+        dt = DT_MAX_US;
+    }
+    dtQ16 = (dt * US_TO_Q16) >> 16;
+
+    error = (altitudeCm << 8) + bias - height;
+    height += mulQ16(speed + (error << (ALT_FUSION_W_SHIFT + 1)), dtQ16);
+    speed += mulQ16(error << (2 * ALT_FUSION_W_SHIFT), dtQ16);
+}
+
+/*
+ * Past ALT_FUSION_FOLD_PA, moves the whole Pa of the bias into the sea
+ * level pressure : the next barometric altitudes take them, the fused one
+ * does not move.
+ */
+static void foldBias(void) {
+    int32_t cmPerPa = (BARO_ALT_SCALE_CM - lastBaroCm) * BARO_EXPONENT_Q10 / seaLevelPa; // Q10
+    int32_t biasQ10 = bias << 2;
+    int32_t pa;
+
+    if (cmPerPa <= 0
+            || (biasQ10 < ALT_FUSION_FOLD_PA * cmPerPa && biasQ10 > -ALT_FUSION_FOLD_PA * cmPerPa)) {
+        return;
+    }
+    pa = (biasQ10 + (biasQ10 < 0 ? -cmPerPa : cmPerPa) / 2) / cmPerPa;
+    if (seaLevelPa + pa < SEA_LEVEL_PA_MIN) {
+        pa = SEA_LEVEL_PA_MIN - seaLevelPa;
+    } else if (seaLevelPa + pa > SEA_LEVEL_PA_MAX) {
+        pa = SEA_LEVEL_PA_MAX - seaLevelPa;
+    }
+    seaLevelPa += pa;
+    bias -= (pa * cmPerPa) >> 2;
+}
+
+/*
+ * Gain of a GPS altitude elapsedUs after the last one, Q16 : elapsed / tau,
+ * 65536 (all of the difference) from tau.
+ */
+static uint32_t gpsGain(uint32_t elapsedUs) {
+    uint32_t elapsed = elapsedUs >> 10; // 1.024 ms
+    uint32_t gain;
+
+    if (elapsed >= ALT_FUSION_GPS_TAU_MS) {
+        return 65536;
+    }
+    gain = (elapsed * GPS_GAIN_Q24) >> 8;
+    return gain < 65536 ? gain : 65536;
+}
+
+void alt_fusion_gps(int32_t altitudeCm, uint16_t hdop_c) {
+    int32_t correction;
+    uint32_t gain;
+
+    if (!started || hdop_c > ALT_FUSION_HDOP_MAX) {
+        return;
+    }
+    correction = (altitudeCm << 8) - height;
+    gain = gpsGain(lastMicros - gpsMicros);
+    gpsMicros = lastMicros;
+    if (anchored && gain < 65536) {
+        correction = mulQ16(correction, gain);
+    }
+    anchored = 1;
+    bias += correction;
+    height += correction;
+    foldBias();
+}
+
+int32_t alt_fusion_altitude_cm(void) {
+    return roundQ8(height);
+}
+
+int16_t alt_fusion_vspeed_cms(void) {
+    int32_t cms = roundQ8(speed);
+
+    if (cms > 32767) {
+        return 32767;
+    }
+    if (cms < -32768) {
+        return -32768;
+    }
+    return cms;
+}
+
+int32_t alt_fusion_sea_level_pa(void) {
+    return seaLevelPa;
+}
@@ -0,0 +1,81 @@
+/*
+ * AltitudeFusion.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  GPS / barometer altitude fusion : the barometer is precise from one
+ *  sample to the next but drifts with the weather, the GPS altitude is
+ *  noisy but does not drift. Integer only.
+ *
+ *  At baro rate, a second order complementary filter (critically damped,
+ *  w = 2^ALT_FUSION_W_SHIFT rad/s) tracks the barometric altitude plus a
+ *  bias, and gives the altitude and the vertical speed :
+ *      e  = baro + bias - h
+ *      h += (v + 2w e) dt
+ *      v += w^2 e dt
+ *  At GPS rate, a good GPS altitude pulls the bias by dt/ALT_FUSION_GPS_TAU_MS
+ *  of the difference, dt the time since the last one : the same time
+ *  constant at 1 or 10 Hz (the first one, or one after more than tau, sets
+ *  it). Past ALT_FUSION_FOLD_PA, the whole Pa of bias are folded into the
+ *  sea level pressure estimate, for the barometric altitude to be computed
+ *  against it : hpa0 keeps following the weather, in steps that are not
+ *  taken at each fix (each one recomputes the barometric reference).
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef ALTITUDEFUSION_H_
+#define ALTITUDEFUSION_H_
+
+#include <stdint.h>
+
+// w = 2 rad/s : about 0.5 s to follow a climb, vertical speed included
+#ifndef ALT_FUSION_W_SHIFT
+#define ALT_FUSION_W_SHIFT 1
+#endif
+
+// Bias time constant, ms
+#ifndef ALT_FUSION_GPS_TAU_MS
+#define ALT_FUSION_GPS_TAU_MS 64000UL
+#endif
+
+// Bias folded into the sea level pressure from that, Pa (10 Pa : about 85 cm)
+#ifndef ALT_FUSION_FOLD_PA
+#define ALT_FUSION_FOLD_PA 10
+#endif
+
+// GPS altitudes with a worse HDOP are ignored, 1/100
+#ifndef ALT_FUSION_HDOP_MAX
+#define ALT_FUSION_HDOP_MAX 300
+#endif
+
+/*
+ * Starts over, from the sea level pressure in Pa. The filter starts on the
+ * next barometric altitude.
+ */
+void alt_fusion_begin(int32_t seaLevelPa);
+
+/*
+ * A barometric altitude in cm, computed against alt_fusion_sea_level_pa(),
+ * and the micros() of its sample.
+ */
+void alt_fusion_baro(int32_t altitudeCm, uint32_t sampleMicros);
+
+/*
+ * A GPS altitude in cm, from a valid fix, with its HDOP in 1/100. May move
+ * the sea level pressure.
+ */
+void alt_fusion_gps(int32_t altitudeCm, uint16_t hdop_c);
+
+// Fused altitude in cm, 0 before the first barometric altitude.
+int32_t alt_fusion_altitude_cm(void);
+
+// Vertical speed in cm/s, up is positive.
+int16_t alt_fusion_vspeed_cms(void);
+
+// Sea level pressure estimate in Pa.
+int32_t alt_fusion_sea_level_pa(void);
+
+#endif /* ALTITUDEFUSION_H_ */
@@ -32,7 +32,13 @@
  ****************************************************/
 
 #include "BMP085.h"
-#include "Wire.h"
+#include "BaroAltitude.h"
+#include "Twi.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#endif
 
 /****************
  * internal types
@@ -40,16 +46,11 @@
 typedef enum {
     NONE,
     TEMPERATURE_IN_PROGRESS,
-    PRESSURE_IN_PROGRESS
+    PRESSURE_IN_PROGRESS,
+    PRESSURE_READING //conversion over, raw value on its way on the bus
 } cycleStep_t;
 
-/****************
- * Function prototypes
- *****************/
-
-uint8_t read8(uint8_t addr);
-uint16_t read16(uint8_t addr);
-void write8(uint8_t addr, uint8_t data);
+#define BMP085_CAL_LENGTH 22 //AC1 to MD
 
 /***************************
  * Internal data
@@ -58,6 +59,17 @@ void write8(uint8_t addr, uint8_t data);
 cycleStep_t currentStep = NONE;
 uint8_t oversampling;
 uint8_t eocPinNumber; //for End of Conversion flag readings
+boolean eocInterrupt = false; //EOC seen by the pin change interrupt, instead of polling
+volatile boolean eocRaised = false;
+volatile unsigned long eocMicros;
+unsigned long sampleMicros; //end of the last pressure conversion
+
+//I2C transactions, run in the background by the TWI interrupt
+uint8_t commandBuffer[2]; //control register, command
+uint8_t registerAddress;
+uint8_t rawBuffer[3];
+twiTransaction_t commandTx = { BMP085_I2CADDR, commandBuffer, 2, NULL, 0, TWI_OK };
+twiTransaction_t readTx = { BMP085_I2CADDR, &registerAddress, 1, rawBuffer, 0, TWI_OK };
 
 //the following names match the datasheet.
 
@@ -66,11 +78,55 @@ int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
 uint16_t ac4, ac5, ac6;
 int16_t UT; //RAW temp
 int32_t UP; //RAW pressure
+int32_t B5; //from UT, kept until the next temperature conversion
+
+//temperature decimation
+uint8_t temperatureEvery = 1; //pressure conversions per temperature one
+uint16_t temperatureMaxAgeMs = 1000;
+uint8_t pressuresSinceTemperature;
+unsigned long temperatureMillis; //start of the last temperature conversion
+boolean temperatureReading = false; //UT on its way on the bus
+cycleStep_t stepAfterReading; //conversion running while UP is read
+
+float altitudeReference = 101325; //sea level pressure folded in the altitude engine
 
 
 /***************************
  * Real code starts here
  ****************************/
+/**
+ * Queues the read of length registers from reg, into rawBuffer. A full
+ * queue is a bus error : false, and the cycle starts again.
+ */
+static boolean readRegisters(uint8_t reg, uint8_t length) {
+    registerAddress = reg;
+    readTx.rxLength = length;
+    if (!twi_queue(&readTx)) {
+        readTx.status = TWI_ERROR;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Calibration word of register reg, from the calibration burst.
+ */
+static uint16_t calibrationWord(const uint8_t* calibration, uint8_t reg) {
+    const uint8_t* word = calibration + (reg - BMP085_CAL_AC1);
+    return ((uint16_t)word[0] << 8) | word[1];
+}
+
+/**
+ * Temperature part of the datasheet computation, for a new UT.
+ */
+static void updateB5(void) {
+    int32_t X1, X2;
+
+    X1 = (((int32_t)UT - (int32_t)ac6) * (int32_t)ac5) >> 15;
+    X2 = ((int32_t)mc * 2048) / (X1 + (int32_t)md);
+    B5 = X1 + X2;
+}
+
 /**
  * Sets the sampling mode, EOC pin number, check the BMP presence then retrieve the
  * calibration factors
@@ -78,36 +134,142 @@ int32_t UP; //RAW pressure
  * return true if captor is present and init successful.
  */
 boolean beginBMP085(uint8_t mode, uint8_t pin) {
+    uint8_t calibrationAddress = BMP085_CAL_AC1;
+    uint8_t calibration[BMP085_CAL_LENGTH];
+    twiTransaction_t calibrationTx = { BMP085_I2CADDR, &calibrationAddress, 1,
+                                       calibration, BMP085_CAL_LENGTH, TWI_OK };
+
     oversampling = mode;
     if (oversampling > BMP085_ULTRAHIGHRES) {
         oversampling = BMP085_ULTRAHIGHRES;
     }
     eocPinNumber = pin;
+    currentStep = NONE;
+    temperatureReading = false;
 
-    Wire.begin();
+    twi_begin();
 
-    if (read8(0xD0) != 0x55) {
+    if (!readRegisters(0xD0, 1) || twi_wait(&readTx) != TWI_OK || rawBuffer[0] != 0x55) {
         return false;
     }
 
-    /* read calibration data */
-    ac1 = read16(BMP085_CAL_AC1);
-    ac2 = read16(BMP085_CAL_AC2);
-    ac3 = read16(BMP085_CAL_AC3);
-    ac4 = read16(BMP085_CAL_AC4);
-    ac5 = read16(BMP085_CAL_AC5);
-    ac6 = read16(BMP085_CAL_AC6);
+    /* read calibration data, in one burst */
+    if (!twi_queue(&calibrationTx) || twi_wait(&calibrationTx) != TWI_OK) {
+        return false;
+    }
+    ac1 = calibrationWord(calibration, BMP085_CAL_AC1);
+    ac2 = calibrationWord(calibration, BMP085_CAL_AC2);
+    ac3 = calibrationWord(calibration, BMP085_CAL_AC3);
+    ac4 = calibrationWord(calibration, BMP085_CAL_AC4);
+    ac5 = calibrationWord(calibration, BMP085_CAL_AC5);
+    ac6 = calibrationWord(calibration, BMP085_CAL_AC6);
 
-    b1 = read16(BMP085_CAL_B1);
-    b2 = read16(BMP085_CAL_B2);
+    b1 = calibrationWord(calibration, BMP085_CAL_B1);
+    b2 = calibrationWord(calibration, BMP085_CAL_B2);
 
-    mb = read16(BMP085_CAL_MB);
-    mc = read16(BMP085_CAL_MC);
-    md = read16(BMP085_CAL_MD);
+    mb = calibrationWord(calibration, BMP085_CAL_MB);
+    mc = calibrationWord(calibration, BMP085_CAL_MC);
+    md = calibrationWord(calibration, BMP085_CAL_MD);
 
     return true;
 }
 
+/**
+ * Switches to the EOC interrupt mode : the end of conversion is caught, and
+ * timestamped, by a pin change interrupt instead of being polled.
+ * Call after beginBMP085(). Returns false if the EOC pin has no supported
+ * interrupt (polling then goes on).
+ */
+boolean enableBMP085EocInterrupt(void) {
+    eocRaised = false;
+    eocInterrupt = bmp085_eoc_hw_attach(eocPinNumber);
+    return eocInterrupt;
+}
+
+/**
+ * Interrupt body, called on a rising EOC.
+ */
+void bmp085_eoc_rise(void) {
+    eocMicros = micros();
+    eocRaised = true;
+}
+
+/**
+ * Temperature decimation : a temperature conversion every `every` pressure
+ * conversions (1 : alternate, the default), and at least each maxAgeMs.
+ * Compensation reuses the last temperature in between.
+ */
+void setBMP085TemperatureRate(uint8_t every, uint16_t maxAgeMs) {
+    temperatureEvery = every > 0 ? every : 1;
+    temperatureMaxAgeMs = maxAgeMs;
+}
+
+/**
+ * True if the running conversion is done. Its end time goes to *endMicros :
+ * the interrupt time, or now when polling.
+ */
+static boolean conversionDone(unsigned long* endMicros) {
+    boolean done = false;
+
+    if (commandTx.status == TWI_PENDING) {
+        //not even started, EOC is still high from the previous one
+        return false;
+    }
+    if (!eocInterrupt) {
+        if (digitalRead(eocPinNumber) > 0) {
+            *endMicros = micros();
+            done = true;
+        }
+        return done;
+    }
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+    {
+        if (eocRaised) {
+            eocRaised = false;
+            *endMicros = eocMicros;
+            done = true;
+        }
+    }
+    return done;
+}
+
+/**
+ * Queues the start of a conversion. The flag of the previous one is
+ * cleared first : EOC only goes low once the command is received. A full
+ * queue is a bus error, as for readRegisters().
+ */
+static void startConversion(uint8_t command) {
+    eocRaised = false;
+    commandBuffer[0] = BMP085_CONTROL;
+    commandBuffer[1] = command;
+    if (!twi_queue(&commandTx)) {
+        commandTx.status = TWI_ERROR;
+    }
+}
+
+/**
+ * Starts the conversion following a pressure one : temperature if it is
+ * due, pressure again otherwise. Returns the matching step.
+ */
+static cycleStep_t startNextConversion(void) {
+    if (pressuresSinceTemperature >= temperatureEvery
+            || millis() - temperatureMillis >= temperatureMaxAgeMs) {
+        startConversion(BMP085_READTEMPCMD);
+        temperatureMillis = millis();
+        pressuresSinceTemperature = 0;
+        return TEMPERATURE_IN_PROGRESS;
+    }
+    startConversion(BMP085_READPRESSURECMD + (oversampling << 6));
+    pressuresSinceTemperature++;
+    return PRESSURE_IN_PROGRESS;
+}
+
+unsigned long getBMP085SampleMicros(void) {
+    return sampleMicros;
+}
+
 /********************
  * Main sequencing algorithm, designed to be included in the main loop.
  * Implements the following sequence
@@ -115,46 +277,77 @@ boolean beginBMP085(uint8_t mode, uint8_t pin) {
  *    When raw temp is ready, decode it and then ask for a RAW pressure read
  *    When RAW pressure read is ready, decode it and signal the caller by a true return
  *
- * State change is done by polling at each call the EOC pin value.
+ * State change is done by polling at each call the EOC pin value, or the
+ * flag set by the EOC interrupt (see enableBMP085EocInterrupt()).
+ * I2C transfers are queued and run by the TWI interrupt : a call never
+ * waits for the bus. A raw value read is picked up by a later call.
+ * Temperature conversions may be skipped, see setBMP085TemperatureRate().
  *
  *******************/
 boolean updateBMP085Cycle(void) {
     boolean cycleComplete = false;
+    unsigned long endMicros;
+
+    if (commandTx.status == TWI_ERROR || readTx.status == TWI_ERROR) {
+        if (commandTx.status == TWI_PENDING || readTx.status == TWI_PENDING) {
+            //the other one is still queued : its status and buffers are the TWI's
+            return false;
+        }
+        //sensor or bus trouble : start a new cycle
+        commandTx.status = TWI_OK;
+        readTx.status = TWI_OK;
+        currentStep = NONE;
+    }
 
     switch (currentStep) {
         case NONE :
             //start with a temp read
-            write8(BMP085_CONTROL, BMP085_READTEMPCMD);
+            startConversion(BMP085_READTEMPCMD);
+            temperatureMillis = millis();
+            pressuresSinceTemperature = 0;
             currentStep = TEMPERATURE_IN_PROGRESS;
             break;
         case TEMPERATURE_IN_PROGRESS :
-            if (digitalRead(eocPinNumber) > 0) {
-                //temp read complete, updating data !
-                UT = read16(BMP085_TEMPDATA);
+            if (conversionDone(&endMicros)) {
+                //temp read complete, fetching data !
+                readRegisters(BMP085_TEMPDATA, 2);
+                temperatureReading = true;
 
                 //reading pressure next
-                write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+                startConversion(BMP085_READPRESSURECMD + (oversampling << 6));
+                pressuresSinceTemperature++;
                 currentStep = PRESSURE_IN_PROGRESS;
             }
             //else conversion is still running, about 5ms in high res
             break;
         case PRESSURE_IN_PROGRESS :
-            if (digitalRead(eocPinNumber) > 0) {
-                //temp read complete, updating data !
-                UP = read16(BMP085_PRESSUREDATA);
-
-                UP <<= 8;
-                UP |= read8(BMP085_PRESSUREDATA + 2);
+            if (conversionDone(&endMicros)) {
+                if (temperatureReading) {
+                    //the temp read went before the pressure command : it is over
+                    UT = ((uint16_t)rawBuffer[0] << 8) | rawBuffer[1];
+                    updateB5();
+                    temperatureReading = false;
+                }
+
+                //pressure read complete, fetching data !
+                sampleMicros = endMicros;
+                readRegisters(BMP085_PRESSUREDATA, 3);
+
+                //next conversion while it is read
+                stepAfterReading = startNextConversion();
+                currentStep = PRESSURE_READING;
+            }
+            //else conversion is still running, about 5ms (low pow) to 26ms (high res)
+            break;
+        case PRESSURE_READING :
+            if (readTx.status == TWI_OK) {
+                UP = ((uint32_t)rawBuffer[0] << 16) | ((uint16_t)rawBuffer[1] << 8) | rawBuffer[2];
                 UP >>= (8 - oversampling);
-
-                //reading temperature next
-                write8(BMP085_CONTROL, BMP085_READTEMPCMD);
-                currentStep = TEMPERATURE_IN_PROGRESS;
+                currentStep = stepAfterReading;
 
                 //And a cycle has been completed
                 cycleComplete = true;
             }
-            //else conversion is still running, about 5ms (low pow) to 26ms (high res)
             break;
         default :
             //should not happen
@@ -165,22 +358,18 @@ boolean updateBMP085Cycle(void) {
 
 
 /**
- * Convert current raw values to the understable values.
- * Values might be outdated if call is done in between
- * true return of updateBMP085Cycle() calls.
+ * Convert current raw values to temperature (0.1 degC) and pressure (Pa).
+ * Integer computation of the datasheet, step by step : the powers of two
+ * are shifts (floor, as in the datasheet C code), and the result is
+ * bit exact with its example (UT 27898, UP 23843 : 150, 69964).
+ * The temperature part (B5) is done once per UT, by updateB5().
  */
-void readBMP085All(float sealevelPressure,
-                        bmpData_t* pt_outputData) {
-    int32_t B3, B5, B6, X1, X2, X3;
+void compensateBMP085(bmpData_t* pt_outputData) {
+    int32_t B3, B6, X1, X2, X3;
     uint32_t B4, B7;
+    int32_t p;
 
-    // do temperature calculations
-    X1 = (UT - (int32_t)ac6) * ((int32_t)ac5) / pow(2,15);
-    X2 = ((int32_t)mc * pow(2,11)) / (X1+(int32_t)md);
-    B5 = X1 + X2;
-
-    pt_outputData->temperature = (B5+8)/pow(2,4);
-    pt_outputData->temperature /= 10;
+    pt_outputData->temperature = (B5 + 8) >> 4;
 
     // do pressure calcs
     B6 = B5 - 4000;
@@ -196,60 +385,68 @@ void readBMP085All(float sealevelPressure,
     B7 = ((uint32_t)UP - B3) * (uint32_t)( 50000UL >> oversampling );
 
     if (B7 < 0x80000000) {
-        pt_outputData->pressure = (B7 * 2) / B4;
+        p = (B7 * 2) / B4;
     } else {
-        pt_outputData->pressure = (B7 / B4) * 2;
+        p = (B7 / B4) * 2;
     }
 
-    X1 = (pt_outputData->pressure >> 8) * (pt_outputData->pressure >> 8);
+    X1 = (p >> 8) * (p >> 8);
     X1 = (X1 * 3038) >> 16;
-    X2 = (-7357 * pt_outputData->pressure) >> 16;
+    X2 = (-7357 * p) >> 16;
 
-    pt_outputData->pressure = pt_outputData->pressure + ((X1 + X2 + (int32_t)3791)>>4);
+    pt_outputData->pressure = p + ((X1 + X2 + (int32_t)3791)>>4);
+}
 
-    pt_outputData->altitude = 44330 * (1.0 - pow(((float)pt_outputData->pressure) / sealevelPressure, 0.1903));
+/**
+ * Convert current raw values to the understable values.
+ * Values might be outdated if call is done in between
+ * true return of updateBMP085Cycle() calls.
+ */
+void readBMP085All(float sealevelPressure,
+                        bmpData_t* pt_outputData) {
+    compensateBMP085(pt_outputData);
 
+    if (sealevelPressure != altitudeReference) {
+        altitudeReference = sealevelPressure;
+        baro_altitude_reference(lround(sealevelPressure));
+    }
+    pt_outputData->altitude = baro_altitude_cm(pt_outputData->pressure);
 }
 
 /**************************
- * Utility methods.
+ * ATmega328 pin change interrupt.
+ * Pins 8 to 13 (port B) share PCINT0 : that vector belongs to this driver
+ * unless BMP085_EOC_PCINT is 0 (SoftwareSerial, which claims every PCINT
+ * vector, needs it).
  **************************/
+#if defined(__AVR__)
+#if BMP085_EOC_PCINT
 
-uint8_t read8(uint8_t a) {
-    uint8_t ret;
-
-    Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device
-    Wire.write(a); // sends register address to read from
-    Wire.endTransmission(); // end transmission
-
-    Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device
-    Wire.requestFrom(BMP085_I2CADDR, 1);// send data n-bytes read
-    ret = Wire.read(); // receive DATA
-    Wire.endTransmission(); // end transmission
-
-    return ret;
+boolean bmp085_eoc_hw_attach(uint8_t pin) {
+    if (pin < 8 || pin > 13) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        PCMSK0 |= _BV(pin - 8);
+        PCIFR = _BV(PCIF0);
+        PCICR |= _BV(PCIE0);
+    }
+    return true;
 }
 
-uint16_t read16(uint8_t a) {
-    uint16_t ret;
-
-    Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device
-    Wire.write(a); // sends register address to read from
-    Wire.endTransmission(); // end transmission
+ISR(PCINT0_vect) {
+    //both edges trigger, only the rising one ends a conversion
+    if (PINB & _BV(eocPinNumber - 8)) {
+        bmp085_eoc_rise();
+    }
+}
 
-    Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device
-    Wire.requestFrom(BMP085_I2CADDR, 2);// send data n-bytes read
-    ret = Wire.read(); // receive DATA
-    ret <<= 8;
-    ret |= Wire.read(); // receive DATA
-    Wire.endTransmission(); // end transmission
+#else
 
-    return ret;
+boolean bmp085_eoc_hw_attach(uint8_t pin) {
+    (void)pin;
+    return false;
 }
 
-void write8(uint8_t a, uint8_t d) {
-    Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device
-    Wire.write(a); // sends register address to read from
-    Wire.write(d);  // write data
-    Wire.endTransmission(); // end transmission
-}
+#endif
+#endif
@@ -60,14 +60,21 @@
 #define BMP085_READTEMPCMD       0x2E
 #define BMP085_READPRESSURECMD   0x34
 
+/*
+ * 1 : the driver owns the PCINT0 vector, for the EOC interrupt mode (AVR).
+ */
+#ifndef BMP085_EOC_PCINT
+#define BMP085_EOC_PCINT 1
+#endif
+
 #define BMP085_EOC_FINISHED 1
 #define BMP085_EOC_RUNNING 0
 
 
 typedef struct {
-    float temperature; //in degrees
-    int32_t pressure; //in hpa
-    float altitude; // in meters
+    int16_t temperature; //in 0.1 degrees
+    int32_t pressure; //in pa
+    int32_t altitude; // in cm
     float hpa0; //Reference pressure (ie pressure at which the alt value will be zero)
 } bmpData_t;
 
@@ -75,7 +82,26 @@ boolean beginBMP085(uint8_t mode, uint8_t pinNumber);  // by default go highres
 
 boolean updateBMP085Cycle(void);
 
+// Temperature conversion every `every` pressure ones, and each maxAgeMs.
+void setBMP085TemperatureRate(uint8_t every, uint16_t maxAgeMs);
+
+// EOC interrupt mode, instead of polling the pin. False if not available.
+boolean enableBMP085EocInterrupt(void);
+
+// micros() at the end of the last pressure conversion.
+unsigned long getBMP085SampleMicros(void);
+
 void readBMP085All(float sealevelPressure,
                    bmpData_t* pt_outputData); // std atmosphere
 
+// Temperature and pressure only, integer datasheet computation.
+void compensateBMP085(bmpData_t* pt_outputData);
+
+/*
+ * Hardware layer of the EOC interrupt, implemented at the end of BMP085.cpp
+ * for the AVR. Host builds provide their own (see host/hal/mock_hal.cpp).
+ */
+boolean bmp085_eoc_hw_attach(uint8_t pin);
 
+// Interrupt body : called on each rising edge of EOC.
+void bmp085_eoc_rise(void);
@@ -0,0 +1,96 @@
+/*
+ * BaroAltitude.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See BaroAltitude.h.
+ *
+ */
+
+#include <math.h>
+#include <avr/pgmspace.h>
+
+#include "BaroAltitude.h"
+
+#define ALT_MAX_CM 4433000L
+#define SCALE_SHIFT 24
+
+/***************************************************
+* DATA
+***************************************************/
+// Generated by host/altitude_table -g
+const uint32_t baroAltitudeTable[BARO_ALT_POINTS] PROGMEM = {
+    3532369, 3543498, 3554480, 3565319, 3576020, 3586587,
+    3597022, 3607331, 3617515, 3627579, 3637526, 3647358,
+    3657079, 3666691, 3676197, 3685599, 3694901, 3704104,
+    3713210, 3722223, 3731144, 3739974, 3748717, 3757375,
+    3765948, 3774439, 3782849, 3791180, 3799435, 3807613,
+    3815718, 3823750, 3831711, 3839602, 3847425, 3855181,
+    3862871, 3870496, 3878058, 3885557, 3892996, 3900374,
+    3907694, 3914956, 3922161, 3929310, 3936404, 3943444,
+    3950431, 3957366, 3964249, 3971082, 3977866, 3984600,
+    3991287, 3997926, 4004518, 4011065, 4017567, 4024024,
+    4030437, 4036807, 4043135, 4049420, 4055665, 4061869,
+    4068033, 4074157, 4080243, 4086290, 4092299, 4098271,
+    4104206, 4110105, 4115968, 4121796, 4127588, 4133347,
+    4139071, 4144763, 4150420, 4156046, 4161639, 4167200,
+    4172730, 4178229, 4183698, 4189136, 4194544, 4199923,
+    4205272, 4210593, 4215885, 4221149, 4226386, 4231595,
+    4236776, 4241931, 4247060, 4252162, 4257238, 4262289,
+    4267314, 4272315, 4277290, 4282241, 4287168, 4292071,
+    4296950, 4301806, 4306638, 4311447, 4316234, 4320998,
+    4325740, 4330460, 4335159, 4339835, 4344491, 4349125,
+    4353738, 4358331, 4362903, 4367454, 4371986, 4376498,
+    4380990, 4385462, 4389916, 4394350, 4398765, 4403161,
+    4407539, 4411898, 4416239, 4420562, 4424867, 4429155,
+    4433425, 4437677, 4441912, 4446130, 4450331, 4454515,
+    4458683, 4462834, 4466968, 4471087, 4475189, 4479275,
+    4483346, 4487401, 4491440, 4495464, 4499473, 4503467,
+    4507445
+};
+
+static uint32_t referenceScale = 1UL << SCALE_SHIFT; // (101325 / p0) ^ 0.1903
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+void baro_altitude_reference(int32_t seaLevelPa) {
+    referenceScale = (uint32_t)(pow(101325.0 / seaLevelPa, 0.1903) * (1UL << SCALE_SHIFT) + 0.5);
+}
+
+/*
+ * (a * referenceScale) >> SCALE_SHIFT, rounded, by 16 bits halves of 32
+ * bits products. a < 2^23 and referenceScale < 2^25 (any sea level
+ * pressure over 3 kPa) keep each sum in 32 bits.
+ */
+static uint32_t scale(uint32_t a) {
+    uint32_t high = a * (referenceScale >> 16) + (a >> 16) * (referenceScale & 0xFFFF);
+    uint32_t low = (a & 0xFFFF) * (referenceScale & 0xFFFF);
+    return (high + (low >> 16) + (1U << (SCALE_SHIFT - 17))) >> (SCALE_SHIFT - 16);
+}
+
+int32_t baro_altitude_cm(int32_t pressurePa) {
+    uint32_t offset, low, high, a;
+    uint8_t i;
+
+    if (pressurePa < BARO_ALT_PA_MIN) {
+        pressurePa = BARO_ALT_PA_MIN;
+    } else if (pressurePa > BARO_ALT_PA_MAX) {
+        pressurePa = BARO_ALT_PA_MAX;
+    }
+    offset = pressurePa - BARO_ALT_PA_MIN;
+    i = offset >> BARO_ALT_STEP_SHIFT;
+    low = pgm_read_dword(&baroAltitudeTable[i]);
+    if (i == BARO_ALT_POINTS - 1) {
+        a = low;
+    } else {
+        //A grows with p, by less than 2^14 cm per step
+        high = pgm_read_dword(&baroAltitudeTable[i + 1]);
+        a = (high - low) * (offset & ((1U << BARO_ALT_STEP_SHIFT) - 1));
+        a = low + ((a + (1U << (BARO_ALT_STEP_SHIFT - 1))) >> BARO_ALT_STEP_SHIFT);
+    }
+    return ALT_MAX_CM - (int32_t)scale(a);
+}
@@ -0,0 +1,46 @@
+/*
+ * BaroAltitude.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Barometric altitude without pow() :
+ *      alt = 44330 * (1 - (p / p0) ^ 0.1903)
+ *          = 44330 - A(p) * (101325 / p0) ^ 0.1903
+ *  with A(p) = 44330 * (p / 101325) ^ 0.1903 read from a flash table
+ *  (linear interpolation, steps of 512 Pa), and the p0 factor computed
+ *  once, when the reference changes.
+ *
+ *  Table range : 30720 to 110592 Pa (about 9100 m to -700 m). Pressures
+ *  outside of it are clamped.
+ *  Max error against the exact formula (double), over the range, for p0
+ *  from 95000 to 108000 Pa : 0.20 m (0.04 m above 90000 Pa).
+ *  Checked by host/altitude_table, which also generates the table.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef BAROALTITUDE_H_
+#define BAROALTITUDE_H_
+
+#include <stdint.h>
+
+#define BARO_ALT_PA_MIN 30720L
+#define BARO_ALT_STEP_SHIFT 9 // 512 Pa
+#define BARO_ALT_POINTS 157
+#define BARO_ALT_PA_MAX (BARO_ALT_PA_MIN + ((int32_t)(BARO_ALT_POINTS - 1) << BARO_ALT_STEP_SHIFT))
+
+// A(p) in cm at BARO_ALT_PA_MIN + i * 512 Pa, in flash.
+extern const uint32_t baroAltitudeTable[BARO_ALT_POINTS];
+
+/*
+ * Sets p0, the pressure of altitude 0 (one pow() call). Until then, the
+ * reference is 101325 Pa.
+ */
+void baro_altitude_reference(int32_t seaLevelPa);
+
+// Altitude in cm of pressure (Pa), for the current reference.
+int32_t baro_altitude_cm(int32_t pressurePa);
+
+#endif /* BAROALTITUDE_H_ */
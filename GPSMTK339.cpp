@@ -16,40 +16,132 @@
  */
 
 #include "GPSMTK339.h"
+#include "GpsUart.h"
+#include "PowersOf10.h"
 #include "avr/pgmspace.h"
 
 /*
-* GPS Commands
+* GPS Commands, "$PMTKnnn,params*CS" : built by send_command()
 */
-// different commands to set the update rate from once a second (1 Hz) to 10 times a second (10Hz)
-#define PMTK_SET_NMEA_UPDATE_1HZ  (char*)("$PMTK220,1000*1F")
-#define PMTK_SET_NMEA_UPDATE_5HZ  (char*)("$PMTK220,200*2C")
-#define PMTK_SET_NMEA_UPDATE_10HZ (char*)("$PMTK220,100*2F")
+#define PMTK_TEST          0   // no parameter, answered by an ACK
+#define PMTK_SET_BAUD      251 // baud ; not acknowledged, the module switches
+#define PMTK_SET_UPDATE    220 // fix interval in ms
+#define PMTK_SET_OUTPUT    314 // 19 output rates, GLL RMC VTG GGA GSA GSV first
 
-#define PMTK_SET_BAUD_57600 "$PMTK251,57600*2C"
-#define PMTK_SET_BAUD_9600  "$PMTK251,9600*17"
+#define PMTK_OUTPUT_FIELDS 19
+#define PMTK_ACK_OK 3          // flags : 0 invalid, 1 unsupported, 2 failed, 3 done
+#define PMTK_COMMAND_MAX 64    // "$PMTK314," + 19 fields + "*CS", NUL
+#define PMTK_NO_ACK 0xFF
 
+// Time for the module to take the new speed, after the PMTK251 line
+#define GPS_BAUD_SWITCH_MS 20
 
-#define PMTK_SET_NMEA_OUTPUT_RMCONLY (char*)("$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29")// turn on only the second sentence (GPRMC)
-#define PMTK_SET_NMEA_OUTPUT_RMCGGA  (char*)("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28") // turn on GPRMC and GGA
-#define PMTK_SET_NMEA_OUTPUT_ALLDATA (char*)("$PMTK314,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0*28")// turn on ALL THE DATA
-#define PMTK_SET_NMEA_OUTPUT_OFF     (char*)("$PMTK314,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28")// turn off output
+#define NMEA_ADDRESS_SIZE 5 //talker + sentence ID, "GPRMC"
+#define PMTK_ADDRESS_SIZE 7 //"PMTK001"
 
-#define GPS_BUFFER_SIZE 120 //In number of ASCII char
+/*
+ * Sentence table slot of a sentence ID : sum of its chars, modulo the
+ * table size. Collision free for RMC (2), GGA (7), VTG (1), GSA (3).
+ */
+#define SENTENCE_TABLE_SIZE 8
+#define SENTENCE_HASH(a, b, c) (((uint8_t)(a) + (uint8_t)(b) + (uint8_t)(c)) & (SENTENCE_TABLE_SIZE - 1))
+
+// Largest mantissa that can still take one more digit
+#define NMEA_MANTISSA_MAX ((0xFFFFFFFFUL - 9) / 10)
 
 /***************************************************
-* DATA
+* TYPES
 ***************************************************/
-const char *search = (char*)(",");
-
-char buffer[GPS_BUFFER_SIZE]; //Serial buffer to catch GPS data
+typedef enum {
+    WAIT_START,   // waiting for '$'
+    IN_ADDRESS,   // talker and sentence ID
+    IN_FIELD,     // data fields, up to '*'
+    IN_CHECKSUM,  // two hex digits after '*'
+} parserState_t;
 
+/*
+ * A data field, converted while its chars arrive :
+ * digits are accumulated in mantissa, decimals counts the ones after the dot.
+ * "4511.3127" gives mantissa 45113127, decimals 4.
+ */
+typedef struct {
+    uint32_t mantissa;
+    uint8_t decimals;
+    boolean dot;
+    boolean negative;
+    boolean empty;
+    char first; //first char, for the single letter fields (N/S, E/W...)
+} nmeaField_t;
+
+// Field decoder of a sentence, called at the end of each data field
+typedef void (*fieldDecoder_t)(void);
+
+typedef struct {
+    char id[3];             // sentence ID, after the talker
+    uint8_t sentence;       // nmeaSentence_t
+    fieldDecoder_t decode;
+} sentenceEntry_t;
 
 /***************************************************
 * FUNCTIONS PROTOTYPES
 ***************************************************/
-boolean parse_rmc(t_gpsData* pt_outputData);
-boolean parse_gga(t_gpsData* pt_outputData);
+static void start_field(void);
+static void end_field(void);
+static void decode_rmc_field(void);
+static void decode_gga_field(void);
+static void decode_vtg_field(void);
+static void decode_gsa_field(void);
+static void decode_ack_field(void);
+static void commit_sentence(t_gpsData* pt_outputData);
+
+/***************************************************
+* DATA
+***************************************************/
+/*
+ * Decoded sentences, at their SENTENCE_HASH slot, whatever the talker (GP
+ * GPS, GN multi constellation...). The others (GSV, GLL...) are dropped at
+ * their address, without looking at their fields.
+ */
+static const sentenceEntry_t sentenceTable[SENTENCE_TABLE_SIZE] PROGMEM = {
+    { { 0, 0, 0 },       NMEA_NONE, NULL },
+    { { 'V', 'T', 'G' }, NMEA_VTG,  decode_vtg_field },
+    { { 'R', 'M', 'C' }, NMEA_RMC,  decode_rmc_field },
+    { { 'G', 'S', 'A' }, NMEA_GSA,  decode_gsa_field },
+    { { 0, 0, 0 },       NMEA_NONE, NULL },
+    { { 0, 0, 0 },       NMEA_NONE, NULL },
+    { { 0, 0, 0 },       NMEA_NONE, NULL },
+    { { 'G', 'G', 'A' }, NMEA_GGA,  decode_gga_field },
+};
+
+// decimals kept in a field : the last power of PowersOf10.h
+#define NMEA_DECIMALS_MAX (POWERS_OF_10 - 1)
+
+static parserState_t state = WAIT_START;
+static nmeaSentence_t sentence;  // being parsed
+static fieldDecoder_t fieldDecoder;
+static char address[PMTK_ADDRESS_SIZE];
+static uint8_t addressLength;
+static uint8_t fieldIndex;       // 1 is the first field after the address
+static nmeaField_t field;
+static boolean sentenceValid;    // false once a field could not be converted
+static byte checksum;            // XOR of the chars between '$' and '*'
+static byte checksumReceived;
+static uint8_t checksumDigits;
+
+static uint16_t checksumErrors = 0;
+static uint16_t resyncs = 0;
+
+// Decoded fields, copied to the caller data only once the checksum is checked.
+static t_gpsData pending;
+static uint16_t pendingAckCommand;
+static uint8_t pendingAckFlag;
+
+// Last PMTK001 received
+static uint16_t ackCommand;
+static uint8_t ackFlag;
+
+static unsigned long lineBaud = GPS_DEFAULT_BAUD;
+
 
 
 /***************************************************
@@ -57,83 +149,399 @@ boolean parse_gga(t_gpsData* pt_outputData);
 ***************************************************/
 
 /***************
- * Init the chip.
+ * Init the serial line, at the power on speed of the chip.
  */
 void begin_gps(void) {
-    //TODO add some more user params...
-    //GPS init
-    Serial.begin(9600);
+    lineBaud = GPS_DEFAULT_BAUD;
+    gps_uart_begin(lineBaud);
     delay(10);
-    Serial.println(PMTK_SET_NMEA_OUTPUT_RMCGGA);
-    Serial.println(PMTK_SET_NMEA_UPDATE_1HZ);
+}
+
+/*
+ * Decimal digits of value at p, returns the end.
+ */
+static char* put_decimal(char* p, uint32_t value) {
+    char digits[10];
+    uint8_t n = 0;
+
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+static char hex_digit(uint8_t value) {
+    return value < 10 ? '0' + value : 'A' + value - 10;
+}
+
+/*
+ * Sends "$PMTK<command><params>*CS" : params holds the text after the
+ * command number, commas included.
+ */
+static void send_command(uint16_t command, const char* params) {
+    char line[PMTK_COMMAND_MAX];
+    char* p = line;
+    byte sum = 0;
+    uint8_t i;
+
+    *p++ = '$';
+    *p++ = 'P';
+    *p++ = 'M';
+    *p++ = 'T';
+    *p++ = 'K';
+    if (command < 100) {
+        *p++ = '0';
+    }
+    if (command < 10) {
+        *p++ = '0';
+    }
+    p = put_decimal(p, command);
+    while (*params && p < line + PMTK_COMMAND_MAX - 4) {
+        *p++ = *params++;
+    }
+    for (i = 1; line + i < p; i++) {
+        sum ^= line[i];
+    }
+    *p++ = '*';
+    *p++ = hex_digit(sum >> 4);
+    *p++ = hex_digit(sum & 0x0F);
+    *p = 0;
+    gps_uart_println(line);
+}
+
+/*
+ * Reads the line up to the PMTK001 of command, or the timeout.
+ * Returns its flag, PMTK_NO_ACK on timeout.
+ */
+static uint8_t wait_ack(uint16_t command) {
+    t_gpsData discarded;
+    unsigned long start = millis();
+    int c;
+
+    while (millis() - start < GPS_ACK_TIMEOUT_MS) {
+        c = gps_uart_read();
+        if (c < 0) {
+            delay(1);
+        } else if (gps_parse_nmea_char(c, &discarded) == NMEA_PMTK_ACK
+                && ackCommand == command) {
+            return ackFlag;
+        }
+    }
+    return PMTK_NO_ACK;
+}
+
+static boolean command_acked(uint16_t command, const char* params) {
+    send_command(command, params);
+    return wait_ack(command) == PMTK_ACK_OK;
+}
+
+boolean gps_set_baud(unsigned long baud) {
+    unsigned long previous = lineBaud;
+    char params[12];
+
+    if (baud == lineBaud) {
+        return command_acked(PMTK_TEST, "");
+    }
+    if (command_acked(PMTK_TEST, "")) {
+        params[0] = ',';
+        *put_decimal(params + 1, baud) = 0;
+        send_command(PMTK_SET_BAUD, params);
+        delay(GPS_BAUD_SWITCH_MS);
+    }
+    //else may be at the new speed already
+    lineBaud = baud;
+    gps_uart_begin(lineBaud);
+    if (command_acked(PMTK_TEST, "")) {
+        return true;
+    }
+    lineBaud = previous;
+    gps_uart_begin(lineBaud);
+    return false;
+}
+
+boolean gps_set_update_interval(uint16_t intervalMs) {
+    char params[8];
+
+    params[0] = ',';
+    *put_decimal(params + 1, intervalMs) = 0;
+    return command_acked(PMTK_SET_UPDATE, params);
+}
+
+boolean gps_set_sentences(uint8_t sentences) {
+    char params[2 * PMTK_OUTPUT_FIELDS + 1];
+    char* p = params;
+    uint8_t i;
+
+    for (i = 0; i < PMTK_OUTPUT_FIELDS; i++) {
+        *p++ = ',';
+        *p++ = i < 6 && (sentences & (1 << i)) ? '1' : '0';
+    }
+    *p = 0;
+    return command_acked(PMTK_SET_OUTPUT, params);
 }
 
 /*************************************************************************
-* This functions parses the NMEA strings...
-* Pretty complex but never fails and works well with all GPS modules and baud speeds.. :-)
+* Reads every byte received from the GPS serial line, and decodes it.
 *
-* return true if A valid NMEA sentence was decoded and the t_gpsData given was
-* updated. Update can be partial depending on the sentence.
+* return true once both a RMC and a GGA sentence have been decoded since the
+* previous true return : t_gpsData given then holds a complete fix.
 *************************************************************************/
 boolean gps_read_serial_and_parse_nmea(t_gpsData* pt_gps_data)
 {
-    static byte unlock=1; //some kind of event flag
-    static byte counter=0; //general counter
     static boolean rmc_ready = false;
     static boolean gga_ready = false;
 
     boolean res = false;
+    int c;
 
-    while(Serial.available() > 0)
+    while ((c = gps_uart_read()) >= 0)
     {
-        if(unlock==0)
-        {
-            buffer[0]=Serial.read();//puts a byte in the buffer
-            if(buffer[0]=='$')//Verify if is the preamble $
-            {
-                unlock=1;
-            }
+        switch (gps_parse_nmea_char(c, pt_gps_data)) {
+            case NMEA_RMC :
+                rmc_ready = true;
+                break;
+            case NMEA_GGA :
+                gga_ready = true;
+                break;
+            default :
+                break;
         }
-        else
-        {
-            buffer[counter]=Serial.read();
-            if(buffer[counter]==0x0A) //Looks for \F
-            {
-                unlock=0;
 
+        if (gga_ready && rmc_ready) {
+            gga_ready = false;
+            rmc_ready = false;
+            res = true;
+        }
+    }
+    return res;
+}
 
-                rmc_ready = rmc_ready | parse_rmc(pt_gps_data);
+/*************************************************************************
+* NMEA decoding state machine, fed one char at a time.
+*
+* The checksum is computed as the chars arrive, the sentence is identified
+* as soon as its address field is complete (sentences we don't decode are
+* then skipped up to the next '$'), and each data field is converted while
+* it is received. Per char cost is therefore bounded, with no line buffer.
+*
+* return the sentence type once a sentence has been decoded, checked against
+* its checksum and copied to pt_outputData, NMEA_NONE otherwise.
+*************************************************************************/
+nmeaSentence_t gps_parse_nmea_char(char c, t_gpsData* pt_outputData) {
+    nmeaSentence_t res = NMEA_NONE;
 
-                gga_ready = gga_ready | parse_gga(pt_gps_data);
+    if (c == '$') {
+        //start of sentence, from any state : resync on a truncated sentence
+        if (state != WAIT_START) {
+            resyncs++;
+        }
+        state = IN_ADDRESS;
+        checksum = 0;
+        addressLength = 0;
+        sentence = NMEA_NONE;
+        return res;
+    }
 
-                if (gga_ready && rmc_ready) {
-                    gga_ready = false;
-                    rmc_ready = false;
-                    res = true;
+    switch (state) {
+        case IN_ADDRESS :
+            checksum ^= c;
+            if (c != ',') {
+                if (addressLength < PMTK_ADDRESS_SIZE) {
+                    address[addressLength] = c;
                 }
-
-                for(int a=0; a<=counter; a++)//restarting the buffer
-                {
-                    buffer[a]=0;
+                addressLength++;
+                break;
+            }
+            if (addressLength == NMEA_ADDRESS_SIZE && address[0] == 'G') {
+                sentenceEntry_t entry;
+                memcpy_P(&entry, &sentenceTable[SENTENCE_HASH(address[2], address[3], address[4])], sizeof(entry));
+                if (entry.id[0] == address[2] && entry.id[1] == address[3] && entry.id[2] == address[4]) {
+                    sentence = (nmeaSentence_t)entry.sentence;
+                    fieldDecoder = entry.decode;
                 }
-                counter=0; //Restarting the counter
+            } else if (addressLength == PMTK_ADDRESS_SIZE && memcmp(address, "PMTK001", PMTK_ADDRESS_SIZE) == 0) {
+                sentence = NMEA_PMTK_ACK;
+                fieldDecoder = decode_ack_field;
+                pendingAckFlag = PMTK_NO_ACK;
             }
-            else
-            {
-                counter++; //Incrementing counter
-// TODO check for overflow
-//                if (counter > GPS_BUFFER_SIZE) {
-//                    fatal_error_overflow();
-//                }
+            if (sentence == NMEA_NONE) {
+                //not decoded, skip up to the next '$'
+                state = WAIT_START;
+                break;
             }
-        }
+            fieldIndex = 1;
+            sentenceValid = true;
+            start_field();
+            state = IN_FIELD;
+            break;
+
+        case IN_FIELD :
+            if (c == '*') {
+                end_field();
+                checksumReceived = 0;
+                checksumDigits = 0;
+                state = IN_CHECKSUM;
+                break;
+            }
+            checksum ^= c;
+            if (c == ',') {
+                end_field();
+                fieldIndex++;
+                start_field();
+            } else if (c >= '0' && c <= '9') {
+                if (field.mantissa <= NMEA_MANTISSA_MAX && (!field.dot || field.decimals < NMEA_DECIMALS_MAX)) {
+                    field.mantissa = field.mantissa * 10 + (c - '0');
+                    if (field.dot) {
+                        field.decimals++;
+                    }
+                } else if (!field.dot) {
+                    sentenceValid = false; //integer part overflow
+                }
+                //else extra decimals are dropped
+                field.empty = false;
+            } else if (c == '.') {
+                field.dot = true;
+            } else if (c == '-' && field.empty) {
+                field.negative = true;
+            } else if (c == '\r' || c == '\n') {
+                sentenceValid = false; //line ended before the checksum
+                state = WAIT_START;
+            } else if (field.empty && field.first == 0) {
+                field.first = c;
+            }
+            break;
+
+        case IN_CHECKSUM :
+            if (c >= '0' && c <= '9') {
+                checksumReceived = (checksumReceived << 4) | (c - '0');
+            } else if (c >= 'A' && c <= 'F') {
+                checksumReceived = (checksumReceived << 4) | (c - 'A' + 10);
+            } else {
+                state = WAIT_START;
+                break;
+            }
+            if (++checksumDigits == 2) {
+                if (checksumReceived != checksum) {
+                    checksumErrors++;
+                } else if (sentenceValid) {
+                    commit_sentence(pt_outputData);
+                    res = sentence;
+                }
+                state = WAIT_START;
+            }
+            break;
+
+        case WAIT_START :
+        default :
+            break;
     }
     return res;
 }
 
+/*************************************************************************
+* Reception and decoding error counters, since boot.
+*************************************************************************/
+void gps_get_stats(t_gpsStats* pt_stats) {
+    pt_stats->overruns = gps_uart_overruns();
+    pt_stats->checksumErrors = checksumErrors;
+    pt_stats->resyncs = resyncs;
+}
+
+/**************************
+ * Field conversion
+ **************************/
+static void start_field(void) {
+    field.mantissa = 0;
+    field.decimals = 0;
+    field.dot = false;
+    field.negative = false;
+    field.empty = true;
+    field.first = 0;
+}
+
+static void end_field(void) {
+    fieldDecoder();
+}
+
+static uint32_t field_integer_part(void) {
+    return field.mantissa / power_of_10(field.decimals);
+}
+
+#if GPS_FIXED_POINT
+
+/*
+ * Field value scaled to the given number of decimals : "209.63" gives 20963
+ * for 2 decimals. Extra decimals are truncated.
+ */
+static int32_t field_to_fixed(uint8_t decimals) {
+    int32_t value;
+    if (field.decimals >= decimals) {
+        value = field.mantissa / power_of_10(field.decimals - decimals);
+    } else {
+        value = field.mantissa * power_of_10(decimals - field.decimals);
+    }
+    return field.negative ? -value : value;
+}
+
+/*
+ * dddmm.mmmm to 1e-7 degrees, integer only.
+ * Minutes are brought to 7 decimals (always < 60e7, fits in 32 bits)
+ * then divided by 60, rounded to nearest.
+ */
+static int32_t field_to_degrees_e7(void) {
+    uint32_t degrees = field_integer_part() / 100;
+    uint32_t minutes = field.mantissa - degrees * 100 * power_of_10(field.decimals);
+    if (field.decimals <= 7) {
+        minutes *= power_of_10(7 - field.decimals);
+    } else {
+        minutes /= power_of_10(field.decimals - 7);
+    }
+    return degrees * 10000000L + (minutes + 30) / 60;
+}
+
+#else
+
+static float field_to_float(void) {
+    float value = (float)field.mantissa / power_of_10(field.decimals);
+    return field.negative ? -value : value;
+}
+
+/*
+ * Lat/Long in degrees, decimal minutes : dddmm.mmmm
+ * To convert to decimal degrees, divide the minutes by 60 (including decimals)
+ */
+static float field_to_degrees(void) {
+    uint32_t degrees = field_integer_part() / 100;
+    //minutes, decimals included, without the point : 4511.3127 -> 113127
+    uint32_t minutes = field.mantissa - degrees * 100 * power_of_10(field.decimals);
+    return degrees + (float)minutes / (60.0f * power_of_10(field.decimals));
+}
+
+#endif
+
+/*
+ * UTC time : hhmmss.sss
+ */
+static void field_to_time(t_gpsData* pt_data) {
+    uint32_t time = field_integer_part();
+    uint32_t fraction = field.mantissa - time * power_of_10(field.decimals);
+    pt_data->hour = time / 10000;
+    pt_data->minute = (time % 10000) / 100;
+    pt_data->seconds = (time % 100);
+    if (field.decimals >= 3) {
+        pt_data->milliseconds = fraction / power_of_10(field.decimals - 3);
+    } else {
+        pt_data->milliseconds = fraction * power_of_10(3 - field.decimals);
+    }
+}
+
 
 /*************************************************************************
-* This functions parses the GCA string.
+* Fields of the GGA string.
 * Table-2: GGA Data Format
  * Name                    Example      Units/Description
  * Message ID              $GPGGA       GGA protocol header
@@ -153,63 +561,40 @@ boolean gps_read_serial_and_parse_nmea(t_gpsData* pt_gps_data)
  * Checksum                *65
  * <CR> <LF>      End of message termination
  *
- * return true if GPGGA NMEA sentence was successfully decoded, false otherwise.
- *  if true, only the following fields are updated :
+ * Only the following fields are decoded :
  *   fix, sats, hdop, atl_m
  *************************************************************************/
-boolean parse_gga(t_gpsData* pt_outputData) {
-    const  char  head_gga[]        = "GPGGA"; //GPS NMEA header to look for
-    static byte  checksum          = 0; //the checksum generated
-    static byte  checksum_received = 0; //Checksum received
-    char        *token, *brkb;
-    boolean res = false;
-    if (strncmp(buffer, head_gga, 5) == 0)
-    {
-        /*Generating and parsing received checksum, */
-        for(int x=0; x<100; x++)
-        {
-            if(buffer[x] == '*')
-            {
-                checksum_received = strtol(&buffer[x+1], NULL, 16);//Parsing received checksum...
-                break;
-            }
-            else
-            {
-                checksum ^= buffer[x]; //XOR the received data...
-            }
-        }
-
-        if(checksum_received == checksum)//Checking checksum
-        {
-            token = strtok_r(buffer, search, &brkb); //GPGGA header, not used anymore
-            token = strtok_r(NULL,   search, &brkb); //UTC, not used!!
-            token = strtok_r(NULL,   search, &brkb); //lat, not used!!
-            token = strtok_r(NULL,   search, &brkb); //north/south, nope...
-            token = strtok_r(NULL,   search, &brkb); //lon, not used!!
-            token = strtok_r(NULL,   search, &brkb); //wets/east, nope
-            token = strtok_r(NULL,   search, &brkb); //Position fix, used!!
-            pt_outputData->fix = atoi(token);
-
-            token = strtok_r(NULL, search, &brkb); //sats in use, used!!
-            pt_outputData->sats = atoi(token);
-
-            token = strtok_r(NULL, search, &brkb);//HDOP, not needed
-            pt_outputData->hdop = atof(token);
-
-            token = strtok_r(NULL, search, &brkb);//ALTITUDE, is the only meaning of this string.. in meters of course.
-            pt_outputData->alt_m = atof(token);
-
-            res = true;
-        }
-        checksum=0; //Restarting the checksum
+static void decode_gga_field(void) {
+    switch (fieldIndex) {
+        case 6 : //Position fix
+            pending.fix = field_integer_part();
+            break;
+        case 7 : //sats in use
+            pending.sats = field_integer_part();
+            break;
+#if GPS_FIXED_POINT
+        case 8 : //HDOP
+            pending.hdop_c = field_to_fixed(2);
+            break;
+        case 9 : //ALTITUDE, in meters of course.
+            pending.alt_cm = field_to_fixed(2);
+            break;
+#else
+        case 8 : //HDOP
+            pending.hdop = field_to_float();
+            break;
+        case 9 : //ALTITUDE, in meters of course.
+            pending.alt_m = field_to_float();
+            break;
+#endif
+        default : //UTC, lat/lon : taken from RMC
+            break;
     }
-    return res;
 }
 
 
-
 /*************************************************************************
-* This functions parses the RMC string, and dumps relevant data to the file.
+* Fields of the RMC string.
 Name                Example      Units       Description
 Message ID          $GPRMC      RMC protocol header
 UTC Time            064951.000  hhmmss.sss
@@ -226,118 +611,229 @@ Mode                A           A= Autonomous mode D= Differential mode E= Estim
 Checksum            *2C
 <CR> <LF>           End of message termination
 
- * return true if GPRMC NMEA sentence was successfully decoded, false otherwise.
- *  if true, only the following fields are updated :
+ * Only the following fields are decoded :
  *   hour, minute, seconds, millis, lat, lon, speed, heading, day, month, year
 *************************************************************************/
-boolean parse_rmc(t_gpsData* pt_outputData) {
-    const  char  head_rmc[]        = "GPRMC"; //GPS NMEA header to look for
-    static byte  checksum          = 0;
-    static byte  checksum_received = 0;
-
-    char        *token, *brkb, *pEnd;
-    boolean res = false;
-    unsigned long temp          = 0;
-    unsigned long temp2         = 0;
-    unsigned long temp3         = 0;
-    float         latitude_dec  = 0;
-    float         longitude_dec = 0;
-
-
-    if (strncmp (buffer, head_rmc, 5) == 0)
-    {
-        // $GPRMC parsing starts here
-        /*Generating and parsing received checksum, */
-        for(int x=0; x<100; x++)
-        {
-            if(buffer[x]=='*')
-            {
-                checksum_received=strtol(&buffer[x+1],NULL,16);//Parsing received checksum...
-                break;
+static void decode_rmc_field(void) {
+    uint32_t fulldate;
+
+    switch (fieldIndex) {
+        case 1 : //UTC Time
+            field_to_time(&pending);
+            break;
+#if GPS_FIXED_POINT
+        case 3 : //Latitude
+            pending.lat_e7 = field_to_degrees_e7();
+            break;
+        case 4 : //lat, north or south?
+            if (field.first == 'S') {
+                pending.lat_e7 = -pending.lat_e7;
             }
-            else
-            {
-                checksum ^= buffer[x]; //XOR the received data...
+            break;
+        case 5 : //Longitude
+            pending.lon_e7 = field_to_degrees_e7();
+            break;
+        case 6 : //lon, east or west?
+            if (field.first == 'W') {
+                pending.lon_e7 = -pending.lon_e7;
             }
-        }
-        if(checksum_received == checksum)//Checking checksum
-        {
-
-            /*
-             * Token will point to the data between comma "'", returns the data in the order received
-             * THE GPRMC order is: UTC, UTC status ,Lat, N/S indicator, Lon, E/W indicator, speed, course, date, mode, checksum
-             */
-            token = strtok_r(buffer, search, &brkb); //Contains the header GPRMC, not used
-            token = strtok_r(NULL,   search, &brkb); //UTC Time
-            float timef = atof(token);
-            uint32_t time = timef;
-            pt_outputData->hour = time / 10000;
-            pt_outputData->minute = (time % 10000) / 100;
-            pt_outputData->seconds = (time % 100);
-            pt_outputData->milliseconds = fmod(timef, 1.0) * 1000;
-
-            token = strtok_r(NULL, search, &brkb); //Status ? not used...
-
-
-            /*
-             * Lat/Long in degrees, decimal minutes
-             * To convert to decimal degrees, divide the minutes by 60 (including decimals)
-             */
-            token = strtok_r(NULL, search, &brkb);
-            //taking only degrees, and minutes without decimals,
-            temp = strtol (token, &pEnd, 10);
-            //takes only the decimals of the minutes
-            temp2 = strtol (pEnd + 1, NULL, 10);
-            //joining degrees, minutes, and the decimals of minute, now without the point...
-            temp3 = (temp * 10000) + (temp2);
-            //modulo to leave only the decimal minutes, eliminating only the degrees..
-            temp3 = temp3 % 1000000;
-            //Dividing to obtain only the degrees, before was 4750
-            temp /= 100;
-            //Joining everything and converting to float variable...
-            //First i convert the decimal minutes to degrees decimals stored in "temp3", example: 501234/600000= .835390
-            //Then i add the degrees stored in "temp" and add the result from the first step, example 47+.835390=47.835390
-            //The result is stored in "lat" variable...
-            latitude_dec = temp + ( (float)temp3 / 600000 );
-            token = strtok_r(NULL, search, &brkb); //lat, north or south?
-            //If the char is equal to S (south), multiply the result by -1..
-            if(*token == 'S')
-            {
-                latitude_dec = latitude_dec * -1;
+            break;
+        case 7 : //Speed over ground, in knots
+            pending.spd_ckn = field_to_fixed(2);
+            break;
+        case 8 : //Course
+            pending.heading_cdeg = field_to_fixed(2);
+            break;
+#else
+        case 3 : //Latitude
+            pending.lat = field_to_degrees();
+            break;
+        case 4 : //lat, north or south?
+            if (field.first == 'S') {
+                pending.lat = -pending.lat;
             }
-            pt_outputData->lat = latitude_dec;
-
-
-
-            //This the same procedure use in lat, but now for Lon....
-            token = strtok_r(NULL, search, &brkb);
-            temp = strtol (token, &pEnd, 10);
-            temp2 = strtol (pEnd + 1, NULL, 10);
-            temp3 = (temp * 10000) + (temp2);
-            temp3 = temp3 % 1000000;
-            temp /= 100;
-            longitude_dec=temp + ((float)temp3 / 600000);
-            token = strtok_r(NULL, search, &brkb); //lon, east or west?
-            if(*token == 'W')
-            {
-                longitude_dec=longitude_dec * -1;
+            break;
+        case 5 : //Longitude
+            pending.lon = field_to_degrees();
+            break;
+        case 6 : //lon, east or west?
+            if (field.first == 'W') {
+                pending.lon = -pending.lon;
             }
-            pt_outputData->lon = longitude_dec;
+            break;
+        case 7 : //Speed over ground, in knots
+            pending.spd_kmh = field_to_float() * 1.852;
+            break;
+        case 8 : //Course
+            pending.heading = field_to_float();
+            break;
+#endif
+        case 9 : //Date
+            fulldate = field_integer_part();
+            pending.day = fulldate / 10000;
+            pending.month = (fulldate % 10000) / 100;
+            pending.year = (fulldate % 100);
+            break;
+        default : //Status, magnetic variation, mode : not used
+            break;
+    }
+}
 
-            token = strtok_r(NULL, search, &brkb); //Speed overground?
-            pt_outputData->spd_kmh = atof(token) * 1.852;
+/*************************************************************************
+* Fields of the VTG string.
+ * Name                Example   Units       Description
+ * Message ID          $GPVTG
+ * Course              165.48    degrees     True
+ * Reference           T
+ * Course                        degrees     Magnetic, not given
+ * Reference           M
+ * Speed               0.03      knots
+ * Units               N
+ * Speed               0.06      km/h
+ * Units               K
+ * Mode                A         A autonomous, D differential, E estimated
+ *
+ * Only the following fields are decoded :
+ *   heading, speed
+*************************************************************************/
+static void decode_vtg_field(void) {
+    switch (fieldIndex) {
+#if GPS_FIXED_POINT
+        case 1 : //Course
+            pending.heading_cdeg = field_to_fixed(2);
+            break;
+        case 5 : //Speed, in knots
+            pending.spd_ckn = field_to_fixed(2);
+            break;
+#else
+        case 1 : //Course
+            pending.heading = field_to_float();
+            break;
+        case 7 : //Speed, in km/h
+            pending.spd_kmh = field_to_float();
+            break;
+#endif
+        default :
+            break;
+    }
+}
 
-            token = strtok_r(NULL, search, &brkb); //Course?
-            pt_outputData->heading = atof(token);
+/*************************************************************************
+* Fields of the GSA string.
+ * Name                Example   Description
+ * Message ID          $GPGSA
+ * Mode 1              A         M manual, A automatic 2D/3D
+ * Mode 2              3         1 no fix, 2 2D, 3 3D
+ * Satellites used     29        12 fields, channels 1 to 12
+ * PDOP                1.64      Position dilution of precision
+ * HDOP                0.96      Horizontal dilution of precision
+ * VDOP                1.33      Vertical dilution of precision
+ *
+ * Only the following fields are decoded :
+ *   pdop, vdop (hdop comes with GGA)
+*************************************************************************/
+static void decode_gsa_field(void) {
+    switch (fieldIndex) {
+#if GPS_FIXED_POINT
+        case 15 : //PDOP
+            pending.pdop_c = field_to_fixed(2);
+            break;
+        case 17 : //VDOP
+            pending.vdop_c = field_to_fixed(2);
+            break;
+#else
+        case 15 : //PDOP
+            pending.pdop = field_to_float();
+            break;
+        case 17 : //VDOP
+            pending.vdop = field_to_float();
+            break;
+#endif
+        default :
+            break;
+    }
+}
 
-            token = strtok_r(NULL, search, &brkb); //Date?
-            uint32_t fulldate = atof(token);
-            pt_outputData->day = fulldate / 10000;
-            pt_outputData->month = (fulldate % 10000) / 100;
-            pt_outputData->year = (fulldate % 100);
-            res = true;
-        }
-        checksum=0;
-    } //End of the GPRMC parsing
-    return res;
+/*************************************************************************
+* Fields of the PMTK001 string, the answer to a PMTK command.
+ * Name                Example   Description
+ * Message ID          $PMTK001
+ * Command             220       the command answered
+ * Flag                3         0 invalid, 1 unsupported, 2 failed, 3 done
+*************************************************************************/
+static void decode_ack_field(void) {
+    switch (fieldIndex) {
+        case 1 :
+            pendingAckCommand = field_integer_part();
+            break;
+        case 2 :
+            pendingAckFlag = field_integer_part();
+            break;
+        default :
+            break;
+    }
+}
+
+/*
+ * Copies the fields of the checked sentence to the caller data (the
+ * answers to the commands are kept here).
+ */
+static void commit_sentence(t_gpsData* pt_outputData) {
+    switch (sentence) {
+        case NMEA_PMTK_ACK :
+            ackCommand = pendingAckCommand;
+            ackFlag = pendingAckFlag;
+            break;
+        case NMEA_RMC :
+            pt_outputData->hour = pending.hour;
+            pt_outputData->minute = pending.minute;
+            pt_outputData->seconds = pending.seconds;
+            pt_outputData->milliseconds = pending.milliseconds;
+#if GPS_FIXED_POINT
+            pt_outputData->lat_e7 = pending.lat_e7;
+            pt_outputData->lon_e7 = pending.lon_e7;
+            pt_outputData->spd_ckn = pending.spd_ckn;
+            pt_outputData->heading_cdeg = pending.heading_cdeg;
+#else
+            pt_outputData->lat = pending.lat;
+            pt_outputData->lon = pending.lon;
+            pt_outputData->spd_kmh = pending.spd_kmh;
+            pt_outputData->heading = pending.heading;
+#endif
+            pt_outputData->day = pending.day;
+            pt_outputData->month = pending.month;
+            pt_outputData->year = pending.year;
+            break;
+        case NMEA_GGA :
+            pt_outputData->fix = pending.fix;
+            pt_outputData->sats = pending.sats;
+#if GPS_FIXED_POINT
+            pt_outputData->hdop_c = pending.hdop_c;
+            pt_outputData->alt_cm = pending.alt_cm;
+#else
+            pt_outputData->hdop = pending.hdop;
+            pt_outputData->alt_m = pending.alt_m;
+#endif
+            break;
+        case NMEA_VTG :
+#if GPS_FIXED_POINT
+            pt_outputData->spd_ckn = pending.spd_ckn;
+            pt_outputData->heading_cdeg = pending.heading_cdeg;
+#else
+            pt_outputData->spd_kmh = pending.spd_kmh;
+            pt_outputData->heading = pending.heading;
+#endif
+            break;
+        case NMEA_GSA :
+#if GPS_FIXED_POINT
+            pt_outputData->pdop_c = pending.pdop_c;
+            pt_outputData->vdop_c = pending.vdop_c;
+#else
+            pt_outputData->pdop = pending.pdop;
+            pt_outputData->vdop = pending.vdop;
+#endif
+            break;
+        default :
+            break;
+    }
 }
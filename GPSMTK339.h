@@ -12,6 +12,8 @@
  *   - Use with the Adafruit Ultimate GPS module using MTK33x9 chipset
  *          ------> http://www.adafruit.com/products/746
  *   - Some additional decoded data.
+ *   - RMC, GGA, VTG and GSA from any talker (GP, GN...), the other
+ *     sentences are skipped.
  *
  */
 
@@ -21,6 +23,40 @@
 #include "Arduino.h"
 
 
+/*
+ * 0 : positions, altitude, speed... as floats.
+ * 1 : as scaled integers, decoded straight from the NMEA digits. No software
+ *     float on the AVR, and the positions keep the receiver resolution
+ *     (a float only holds ~7 significant digits, about 1m at our latitudes).
+ */
+#ifndef GPS_FIXED_POINT
+#define GPS_FIXED_POINT 0
+#endif
+
+#if GPS_FIXED_POINT
+
+typedef struct {
+    int fix; //Fix and quality, 0 no fix, 1 good fix, 2 differential fix
+    int sats; //number of sats being used for the fix
+    uint16_t hdop_c; // Horizontal dilution of precision, in 1/100
+    int32_t alt_cm; //altitude, in centimeters
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t seconds;
+    uint16_t milliseconds;
+    int32_t lat_e7; //In 1e-7 decimal degrees
+    int32_t lon_e7; //In 1e-7 decimal degrees
+    uint16_t spd_ckn;  //Speed in 1/100 knots
+    uint16_t heading_cdeg; //heading/course/bearing, in 1/100 degrees
+    uint8_t day;
+    uint8_t month;
+    uint8_t year; //int, num of years from year 2000
+    uint16_t pdop_c; //Position dilution of precision (GSA), in 1/100
+    uint16_t vdop_c; //Vertical dilution of precision (GSA), in 1/100
+} t_gpsData;
+
+#else
+
 typedef struct {
     int fix; //Fix and quality, 0 no fix, 1 good fix, 2 differential fix
     int sats; //number of sats being used for the fix
@@ -37,10 +73,70 @@ typedef struct {
     uint8_t day;
     uint8_t month;
     uint8_t year; //int, num of years from year 2000
+    float pdop; //Position dilution of precision (GSA)
+    float vdop; //Vertical dilution of precision (GSA)
 } t_gpsData;
 
+#endif
+
+typedef enum {
+    NMEA_NONE, //no sentence completed, or sentence rejected
+    NMEA_RMC,
+    NMEA_GGA,
+    NMEA_VTG, //course and speed, as RMC
+    NMEA_GSA, //dilutions of precision
+    NMEA_PMTK_ACK //PMTK001, answer to a command
+} nmeaSentence_t;
+
+/*
+ * Output sentences, for gps_set_sentences() : bits in the PMTK314 order.
+ */
+#define GPS_NMEA_GLL 0x01
+#define GPS_NMEA_RMC 0x02
+#define GPS_NMEA_VTG 0x04
+#define GPS_NMEA_GGA 0x08
+#define GPS_NMEA_GSA 0x10
+#define GPS_NMEA_GSV 0x20
+
+// Serial speed of the module at power on
+#define GPS_DEFAULT_BAUD 9600
+
+// How long a command waits for its PMTK001 answer
+#ifndef GPS_ACK_TIMEOUT_MS
+#define GPS_ACK_TIMEOUT_MS 500
+#endif
+
+typedef struct {
+    uint16_t overruns;       //bytes lost before being parsed (see GpsUart.h)
+    uint16_t checksumErrors; //sentences dropped on a bad checksum
+    uint16_t resyncs;        //sentences cut by the start of a new one
+} t_gpsStats;
+
+/*
+ * Opens the serial line at GPS_DEFAULT_BAUD. The module keeps its own
+ * settings until the gps_set_* calls : each one sends its PMTK command and
+ * waits for the PMTK001 answer, true if the module took it. Sentences
+ * received meanwhile are dropped.
+ */
 void begin_gps(void);
 
+/*
+ * Moves the line to baud (PMTK251), then checks the module answers at that
+ * speed. A module already there, e.g. since a previous boot, is found too.
+ * The line stays at its previous speed on failure.
+ */
+boolean gps_set_baud(unsigned long baud);
+
+// Fix interval in ms, 100 (10 Hz) to 10000 (PMTK220).
+boolean gps_set_update_interval(uint16_t intervalMs);
+
+// GPS_NMEA_* bits, each one sent at every fix (PMTK314).
+boolean gps_set_sentences(uint8_t sentences);
+
 boolean gps_read_serial_and_parse_nmea(t_gpsData* pt_outputData);
 
+nmeaSentence_t gps_parse_nmea_char(char c, t_gpsData* pt_outputData);
+
+void gps_get_stats(t_gpsStats* pt_stats);
+
 #endif /* GPSMTK339_H_ */
@@ -3,8 +3,9 @@
 * Connexions :
 *     - Connect the GPS Power pin to 5V
 *     - Connect the GPS Ground pin to ground
-*     - Connect the GPS TX (transmit) pin to Digital 3
-*     - Connect the GPS RX (receive) pin to Digital 2
+*     - Connect the GPS TX (transmit) pin to Digital 0 (USART0 RX)
+*     - Connect the GPS RX (receive) pin to Digital 1 (USART0 TX)
+*     - Connect the GPS PPS pin to Digital 2 (PPS_PIN=2 build)
 *
 * SD :
 *     - MOSI : 12
@@ -26,8 +27,20 @@
 
 #include "Arduino.h"
 #include "SD.h"
+#include "AltitudeFusion.h"
 #include "BMP085.h"
+#include "BaroAltitude.h"
 #include "GPSMTK339.h"
+#include "GpsUart.h"
+#include "LogDelta.h"
+#include "LogFile.h"
+#include "LogFormat.h"
+#include "LogRecord.h"
+#include "LogSession.h"
+#include "Pps.h"
+#include "PressureFilter.h"
+#include "Profile.h"
+#include "Scheduler.h"
 
 /***************************************************
 * DEFINES
@@ -40,15 +53,113 @@
 
 /*
 * Log SD
+* LOG_BINARY 0 : CSV text, 1 : packed binary records (see LogRecord.h)
+* LOG_BARO_RECORDS 1 : a baro record for each BMP085 sample as well, between
+* the GPS ones
+* LOG_DELTA 1 (LogDelta.h, LOG_BINARY) : most records as differences with
+* the previous one
+* LOG_SESSIONS 1 (LogSession.h) : a new file per boot, GPS day and size,
+* indexed in FOLDER, 0 : the single file MYFILE
+* LOG_RAW 1 (LogFile.h) : a preallocated contiguous file written by raw
+* card blocks, MYFILE resumed at each boot, the next name (HZ1_03...) once
+* it is full or not one of LOG_RAW
 */
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+#ifndef LOG_BARO_RECORDS
+#define LOG_BARO_RECORDS 0
+#endif
+#ifndef LOG_DELTA
+#define LOG_DELTA 0
+#endif
+#if LOG_DELTA && !LOG_BINARY
+#error "LOG_DELTA needs LOG_BINARY"
+#endif
+#ifndef LOG_SESSIONS
+#define LOG_SESSIONS !LOG_RAW
+#endif
+#if LOG_SESSIONS && LOG_RAW
+#error "LOG_SESSIONS is for the FAT log, not LOG_RAW"
+#endif
+
 #define SEPARATOR '|'
 #define FOLDER (char*)"LOGS_GPS"
+#if LOG_BINARY
+#define MYFILE (char*)"LOGS_GPS/HZ1_02.bin"
+#define EXTENSION "BIN"
+#else
 #define MYFILE (char*)"LOGS_GPS/HZ1_02.csv"
+#define EXTENSION "CSV"
+#endif
+
+/*
+ * GPS, set at boot
+ * GPS_BAUD : serial line speed, 9600 (power on) to 115200. RMC and GGA take
+ * ~150 bytes per fix : 9600 baud is short of 10 Hz, 57600 is plenty.
+ * GPS_UPDATE_MS : fix interval, 100 (10 Hz) to 10000
+ * GPS_SENTENCES : GPS_NMEA_* sent by the module. A record needs RMC and
+ * GGA, GSA adds the PDOP/VDOP, the others are skipped.
+ */
+#ifndef GPS_BAUD
+#define GPS_BAUD 9600
+#endif
+#ifndef GPS_UPDATE_MS
+#define GPS_UPDATE_MS 1000
+#endif
+#ifndef GPS_SENTENCES
+#define GPS_SENTENCES (GPS_NMEA_RMC | GPS_NMEA_GGA)
+#endif
+/*
+ * GPS_PPS 1 : the PPS output of the module is wired to PIN_PPS, the baro
+ * records are stamped in UTC with it. On by the PPS_PIN of Pps.h, which
+ * Pps.cpp sees too.
+ */
+#ifndef GPS_PPS
+#define GPS_PPS (PPS_PIN != 0)
+#endif
 
 /*
  * BMP085
+ * BMP_EOC_INTERRUPT 1 : end of conversion caught by interrupt, 0 : polled
+ * BMP_TEMPERATURE_EVERY : pressure conversions per temperature one, which
+ * is also done each BMP_TEMPERATURE_MAX_MS
+ * BMP_FILTER : pressure logged for all the samples of a record, see
+ * PressureFilter.h, with BMP_FILTER_PARAM its window or IIR shift
  */
 #define SEA_LEVEL_PRESSURE ((float)101325.0)
+#ifndef BMP_EOC_INTERRUPT
+#define BMP_EOC_INTERRUPT 0
+#endif
+#ifndef BMP_TEMPERATURE_EVERY
+#define BMP_TEMPERATURE_EVERY 4
+#endif
+#define BMP_TEMPERATURE_MAX_MS 1000
+#ifndef BMP_FILTER
+#define BMP_FILTER PRESSURE_FILTER_INTERVAL
+#endif
+#ifndef BMP_FILTER_PARAM
+#define BMP_FILTER_PARAM 0
+#endif
+
+/*
+ * Scheduling (see Scheduler.h), by priority :
+ *  - BMP085 cycle, each pass : a late pass leaves the sensor idle,
+ *  - GPS drain, each pass or each GPS_DRAIN_US (fewer calls, bigger bursts) :
+ *    its deadline is the time half of the RX ring takes at GPS_BAUD,
+ *  - record of a fix, on the pass of the fix : its micros() is the fix time,
+ *  - log card writes, in the background : one card operation per pass.
+ * Deadlines in us, misses are counted per task.
+ */
+#ifndef BMP_DEADLINE_US
+#define BMP_DEADLINE_US 3000
+#endif
+#ifndef GPS_DRAIN_US
+#define GPS_DRAIN_US SCHED_EVERY_PASS
+#endif
+#define GPS_DRAIN_DEADLINE_US (GPS_UART_RX_BUFFER_SIZE * 5000000UL / GPS_BAUD)
+#define RECORD_DEADLINE_US 10000
+#define LOG_DEADLINE_US 500000
 
 /*
 * Pins
@@ -57,6 +168,10 @@
 #define PIN_LED_RED 7
 #define PIN_SWITCH_CALIB 4
 #define PIN_EOC 8
+#define PIN_PPS PPS_PIN
+#if GPS_PPS && defined(__AVR__) && PPS_PIN == 0
+#error "GPS_PPS needs the PPS_PIN of Pps.h"
+#endif
 
 
 /***************************************************
@@ -70,12 +185,35 @@ bmpData_t bmp085Data;
 
 t_gpsData gps_data;
 
+#if LOG_DELTA
+logDeltaState_t logDelta; //previous records written
+#endif
+
 /***************************************************
 * Functions declaration
 ***************************************************/
+boolean runBmp(void);
+boolean runGps(void);
+boolean runRecord(void);
+boolean runLog(void);
 void fatal_error(void);
 void fatal_error_overflow(void);
 void writeGpsData(void);
+void writeBaroData(void);
+void fillGpsRecord(logGpsRecord_t* record);
+void writeFileHeader(void);
+#if LOG_BINARY
+void writeLogHeader(void);
+#endif
+
+
+/***************************************************
+* Tasks, by priority
+***************************************************/
+schedTask_t taskBmp = { runBmp, SCHED_EVERY_PASS, BMP_DEADLINE_US, 0 };
+schedTask_t taskGps = { runGps, GPS_DRAIN_US, GPS_DRAIN_DEADLINE_US, 0 };
+schedTask_t taskRecord = { runRecord, SCHED_ON_RELEASE, RECORD_DEADLINE_US, 0 };
+schedTask_t taskLog = { runLog, SCHED_EVERY_PASS, LOG_DEADLINE_US, SCHED_BACKGROUND };
 
 
 /***************************************************
@@ -87,6 +225,8 @@ void writeGpsData(void);
  */
 void setup()
 {
+    boolean sentencesSet;
+
     //Pin setting
     pinMode(PIN_SWITCH_CALIB, INPUT);
     pinMode(PIN_EOC, INPUT);
@@ -99,13 +239,34 @@ void setup()
     digitalWrite(PIN_LED_RED, LOW);
 
     begin_gps();
-    
+    //less traffic first, then the speed, then the rate it allows. A module
+    //left at GPS_BAUD by the last boot misses the sentences at 9600 : sent
+    //again at its speed.
+    //Refused commands leave the module settings : the log goes on with them.
+    sentencesSet = gps_set_sentences(GPS_SENTENCES);
+    if (gps_set_baud(GPS_BAUD)) {
+        if (!sentencesSet) {
+            gps_set_sentences(GPS_SENTENCES);
+        }
+        gps_set_update_interval(GPS_UPDATE_MS);
+    }
+#if GPS_PPS
+    pinMode(PIN_PPS, INPUT);
+    pps_begin(PIN_PPS); //no UTC in the baro records if not available
+#endif
+
     bmp085Data.hpa0 = SEA_LEVEL_PRESSURE;
 
     //BMP Init
     if (!beginBMP085(BMP085_HIGHRES, PIN_EOC)) {
         fatal_error();
     }
+    setBMP085TemperatureRate(BMP_TEMPERATURE_EVERY, BMP_TEMPERATURE_MAX_MS);
+    pressure_filter_begin(BMP_FILTER, BMP_FILTER_PARAM);
+    alt_fusion_begin(SEA_LEVEL_PRESSURE);
+#if BMP_EOC_INTERRUPT
+    enableBMP085EocInterrupt(); //polling goes on if not available
+#endif
 
     //SD card init
     // see if the card is present and can be initialized:
@@ -113,30 +274,97 @@ void setup()
         fatal_error();
     }
 
-    // Open up the file we're going to log to!
-    File dataFile = SD.open(MYFILE, FILE_WRITE);
-    if (!dataFile) {
+    // Open up the file we're going to log to, it stays open
+#if LOG_SESSIONS
+    if (!log_session_begin(FOLDER, EXTENSION, writeFileHeader)) {
+        fatal_error_overflow();
+    }
+#else
+    if (!logFile.begin(MYFILE)) {
         fatal_error_overflow();
     }
-    dataFile.println("Fix|sats|HDOP|alt(m)|Date|Time|lat|Long|Spd(kmh)|Head|temp|hpa|hpa0|alt|");
-    dataFile.flush();
-    dataFile.close();
+    writeFileHeader();
+#endif
     delay(1000);
     digitalWrite(PIN_LED_GREEN, LOW);
+
+    sched_add(&taskBmp);
+    sched_add(&taskGps);
+    sched_add(&taskRecord);
+    sched_add(&taskLog);
 }
 
 /*************************************************************************
-* Main arduino loop
+* Main arduino loop : a pass of the scheduler
 *************************************************************************/
 void loop() {
+    sched_run();
+}
+
+/*************************************************************************
+ * BMP085 cycle : starts the next conversion as soon as one ends, and
+ * takes the new sample. True on a new sample.
+*************************************************************************/
+boolean runBmp(void) {
+    boolean bmpCycleComplete;
 
-    if (updateBMP085Cycle()) {
+    PROFILE_BEGIN(PROFILE_BMP_CYCLE);
+    bmpCycleComplete = updateBMP085Cycle();
+    PROFILE_END(PROFILE_BMP_CYCLE);
+
+    if (bmpCycleComplete) {
+        PROFILE_BEGIN(PROFILE_BMP_READ);
         readBMP085All(bmp085Data.hpa0, &bmp085Data);
+        pressure_filter_add(bmp085Data.pressure);
+        PROFILE_END(PROFILE_BMP_READ);
+        PROFILE_BEGIN(PROFILE_FUSION);
+        alt_fusion_baro(bmp085Data.altitude, getBMP085SampleMicros());
+        PROFILE_END(PROFILE_FUSION);
+#if LOG_BARO_RECORDS
+        PROFILE_BEGIN(PROFILE_WRITE_BARO);
+        writeBaroData();
+        PROFILE_END(PROFILE_WRITE_BARO);
+#endif
     }
+    return bmpCycleComplete;
+}
 
-    if (gps_read_serial_and_parse_nmea(&gps_data)) {
-        writeGpsData();
+/*************************************************************************
+ * GPS drain : parses what the RX ring holds, releases the record task on
+ * a complete fix. True if there were bytes.
+*************************************************************************/
+boolean runGps(void) {
+    boolean received = gps_uart_available() > 0;
+    boolean gpsDataReady;
+
+    PROFILE_BEGIN(PROFILE_GPS_PARSE);
+    gpsDataReady = gps_read_serial_and_parse_nmea(&gps_data);
+    PROFILE_END(PROFILE_GPS_PARSE);
+
+    if (gpsDataReady) {
+        sched_release(&taskRecord);
     }
+    return received;
+}
+
+boolean runRecord(void) {
+    PROFILE_BEGIN(PROFILE_WRITE_LOG);
+    writeGpsData();
+    PROFILE_END(PROFILE_WRITE_LOG);
+    return true;
+}
+
+boolean runLog(void) {
+    boolean written;
+
+    PROFILE_BEGIN(PROFILE_LOG_SERVICE);
+#if LOG_SESSIONS
+    written = logFile.service() || log_session_service();
+#else
+    written = logFile.service();
+#endif
+    PROFILE_END(PROFILE_LOG_SERVICE);
+    return written;
 }
 
 
@@ -163,54 +391,186 @@ void fatal_error_overflow(void) {
 }
 
 /*************************************************************************
- * Dumps BMP data and GPS data to the SD card.
+ * Dumps BMP data and GPS data to the log buffers, as one binary record (a
+ * delta one with LOG_DELTA) or one CSV line (see LogRecord.h, LogDelta.h,
+ * LogFormat.h), then corrects the altitude
+ * fusion with the GPS altitude : the next BMP samples take the new hpa0.
+ * The fix time names the last PPS edge (GPS_PPS).
 *************************************************************************/
 void writeGpsData(void) {
+    logGpsRecord_t record;
+#if LOG_DELTA
+    uint8_t delta[sizeof(record)];
+    uint8_t size;
+#endif
+#if !LOG_BINARY
+    char line[LOG_TEXT_MAX];
+#endif
+
     digitalWrite(PIN_LED_GREEN, HIGH);
-    File dataFile = SD.open(MYFILE, FILE_WRITE);
-
-    //GGA
-    dataFile.print(gps_data.fix);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.sats);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.hdop);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.alt_m);
-    dataFile.print(SEPARATOR);
-    //RMC
-    dataFile.print("20");
-    dataFile.print(gps_data.year);
-    dataFile.print(gps_data.month);
-    dataFile.print(gps_data.day);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.hour);
-    dataFile.print(gps_data.minute);
-    dataFile.print(gps_data.seconds);
-    dataFile.print(".");
-    dataFile.print(gps_data.milliseconds);
-    dataFile.print(SEPARATOR);
-
-    dataFile.print(gps_data.lat,8);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.lon,8);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.spd_kmh);
-    dataFile.print(SEPARATOR);
-    dataFile.print(gps_data.heading);
-    dataFile.print(SEPARATOR);
-    //BMP
-    dataFile.print(bmp085Data.temperature);
-    dataFile.print(SEPARATOR);
-    dataFile.print(bmp085Data.pressure);
-    dataFile.print(SEPARATOR);
-    dataFile.print(bmp085Data.hpa0);
-    dataFile.print(SEPARATOR);
-    dataFile.print(bmp085Data.altitude);
-    dataFile.print(SEPARATOR);
-
-    dataFile.println();
-    dataFile.flush();
-    dataFile.close();
+    fillGpsRecord(&record);
+#if LOG_SESSIONS
+    //a session due is opened by runLog(), a failed one keeps the current file
+    log_session_check(record.fix, record.year, record.month, record.day,
+                      record.hour, record.minute, record.seconds);
+#endif
+#if LOG_DELTA
+#if LOG_SESSIONS
+    if (log_session_indexed()) {
+        log_delta_reset(&logDelta); //a reader may start here
+    }
+#endif
+    size = log_delta_gps(&logDelta, &record, delta);
+    if (size > 0) {
+        logFile.write(delta, size);
+    } else {
+        logFile.write((const uint8_t*)&record, sizeof(record));
+    }
+#elif LOG_BINARY
+    logFile.write((const uint8_t*)&record, sizeof(record));
+#else
+    logFile.write((const uint8_t*)line, log_format_gps(line, &record));
+#endif
+    if (record.fix) {
+        alt_fusion_gps(record.alt_cm, record.hdop_c);
+        bmp085Data.hpa0 = alt_fusion_sea_level_pa();
+#if GPS_PPS
+        //without a fix, the time may come from the module RTC
+        pps_fix(record.hour, record.minute, record.seconds, record.milliseconds, record.micros);
+#endif
+    }
     digitalWrite(PIN_LED_GREEN, LOW);
 }
+
+/*************************************************************************
+ * Dumps the last BMP sample, stamped with its end of conversion, in
+ * micros() and in UTC when the PPS gives it, to the log buffers
+ * (LOG_BARO_RECORDS).
+*************************************************************************/
+void writeBaroData(void) {
+    logBaroRecord_t record;
+#if GPS_PPS
+    uint32_t utc; //not in the packed record : aligned
+#endif
+#if LOG_DELTA
+    uint8_t delta[sizeof(record)];
+    uint8_t size;
+#endif
+#if !LOG_BINARY
+    char line[LOG_TEXT_MAX];
+#endif
+
+    record.tag.type = LOG_REC_BARO;
+    record.tag.size = sizeof(record);
+    record.micros = getBMP085SampleMicros();
+    record.pressure_pa = bmp085Data.pressure;
+#if GPS_PPS
+    if (!pps_utc(record.micros, &utc)) {
+        utc = LOG_NO_UTC;
+    }
+    record.utc_dms = utc;
+#else
+    record.utc_dms = LOG_NO_UTC;
+#endif
+#if LOG_DELTA
+    size = log_delta_baro(&logDelta, &record, delta);
+    if (size > 0) {
+        logFile.write(delta, size);
+    } else {
+        logFile.write((const uint8_t*)&record, sizeof(record));
+    }
+#elif LOG_BINARY
+    logFile.write((const uint8_t*)&record, sizeof(record));
+#else
+    logFile.write((const uint8_t*)line, log_format_baro(line, &record));
+#endif
+}
+
+/*************************************************************************
+ * Starts a log file : the binary header or the CSV columns.
+*************************************************************************/
+void writeFileHeader(void) {
+#if LOG_BINARY
+    writeLogHeader();
+#if LOG_DELTA
+    log_delta_reset(&logDelta);
+#endif
+#else
+    for (const char* c = logTextColumns; pgm_read_byte(c) != '\0'; c++) {
+        logFile.write(pgm_read_byte(c));
+    }
+    logFile.println();
+#endif
+}
+
+#if LOG_BINARY
+/*************************************************************************
+ * Marks the start of a session in the log : format and version.
+*************************************************************************/
+void writeLogHeader(void) {
+    logHeaderRecord_t header;
+
+    header.tag.type = LOG_REC_HEADER;
+    header.tag.size = sizeof(header);
+    memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+    header.version = LOG_VERSION;
+    logFile.write((const uint8_t*)&header, sizeof(header));
+}
+#endif
+
+/*************************************************************************
+ * Rounds a float to an integer number of 1/scale units.
+*************************************************************************/
+static int32_t roundScaled(float value, float scale) {
+    value *= scale;
+    return (int32_t)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+/*************************************************************************
+ * GPS data of the moment and filtered BMP data since the previous record,
+ * in the integer units of the log.
+*************************************************************************/
+void fillGpsRecord(logGpsRecord_t* record) {
+    pressureInterval_t pressure;
+
+    record->tag.type = LOG_REC_GPS;
+    record->tag.size = sizeof(*record);
+    record->micros = micros();
+
+    record->fix = gps_data.fix;
+    record->sats = gps_data.sats;
+    record->year = gps_data.year;
+    record->month = gps_data.month;
+    record->day = gps_data.day;
+    record->hour = gps_data.hour;
+    record->minute = gps_data.minute;
+    record->seconds = gps_data.seconds;
+    record->milliseconds = gps_data.milliseconds;
+#if GPS_FIXED_POINT
+    record->hdop_c = gps_data.hdop_c;
+    record->alt_cm = gps_data.alt_cm;
+    record->lat_e7 = gps_data.lat_e7;
+    record->lon_e7 = gps_data.lon_e7;
+    record->spd_ckn = gps_data.spd_ckn;
+    record->heading_cdeg = gps_data.heading_cdeg;
+#else
+    record->hdop_c = roundScaled(gps_data.hdop, 100);
+    record->alt_cm = roundScaled(gps_data.alt_m, 100);
+    record->lat_e7 = roundScaled(gps_data.lat, 1e7);
+    record->lon_e7 = roundScaled(gps_data.lon, 1e7);
+    record->spd_ckn = roundScaled(gps_data.spd_kmh, 100 / 1.852f);
+    record->heading_cdeg = roundScaled(gps_data.heading, 100);
+#endif
+    pressure_filter_take(&pressure);
+    record->temperature_dc = bmp085Data.temperature;
+    record->pressure_pa = pressure.filtered;
+    record->hpa0_pa = roundScaled(bmp085Data.hpa0, 1);
+    //hpa0 is folded in by readBMP085All()
+    record->baro_alt_cm = baro_altitude_cm(pressure.filtered);
+    record->pressure_count = pressure.count;
+    record->pressure_min_pa = pressure.min;
+    record->pressure_max_pa = pressure.max;
+    record->fused_alt_cm = alt_fusion_altitude_cm();
+    record->vspeed_cms = alt_fusion_vspeed_cms();
+}
+
@@ -0,0 +1,146 @@
+/*
+ * GpsUart.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See GpsUart.h.
+ *
+ */
+
+#include "GpsUart.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#endif
+
+#define RX_MASK (GPS_UART_RX_BUFFER_SIZE - 1)
+
+#if GPS_UART_RX_BUFFER_SIZE <= 256
+typedef uint8_t ringIndex_t;
+#else
+typedef uint16_t ringIndex_t;
+#endif
+
+/***************************************************
+* DATA
+***************************************************/
+static volatile uint8_t rxRing[GPS_UART_RX_BUFFER_SIZE];
+static volatile ringIndex_t rxHead = 0; // written by the ISR only
+static volatile ringIndex_t rxTail = 0; // written by the consumer only
+static volatile uint16_t rxOverruns = 0;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+void gps_uart_begin(unsigned long baud) {
+    //the RX interrupt may be running already (a new baud rate)
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+    {
+        rxHead = 0;
+        rxTail = 0;
+        rxOverruns = 0;
+    }
+    gps_uart_hw_begin(baud);
+}
+
+/*
+ * Producer side, interrupt context.
+ * One slot is kept free, to tell a full ring from an empty one.
+ */
+void gps_uart_rx_byte(uint8_t c) {
+    ringIndex_t next = (rxHead + 1) & RX_MASK;
+    if (next == rxTail) {
+        rxOverruns++;
+        return;
+    }
+    rxRing[rxHead] = c;
+    rxHead = next;
+}
+
+static ringIndex_t read_head(void) {
+    ringIndex_t head;
+#if defined(__AVR__) && GPS_UART_RX_BUFFER_SIZE > 256
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        head = rxHead;
+    }
+#else
+    head = rxHead;
+#endif
+    return head;
+}
+
+int gps_uart_read(void) {
+    ringIndex_t tail = rxTail;
+    if (tail == read_head()) {
+        return -1;
+    }
+    uint8_t c = rxRing[tail];
+    rxTail = (tail + 1) & RX_MASK;
+    return c;
+}
+
+uint16_t gps_uart_available(void) {
+    return (read_head() - rxTail) & RX_MASK;
+}
+
+void gps_uart_println(const char* line) {
+    while (*line) {
+        gps_uart_hw_write(*line++);
+    }
+    gps_uart_hw_write('\r');
+    gps_uart_hw_write('\n');
+}
+
+uint16_t gps_uart_overruns(void) {
+    uint16_t overruns;
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        overruns = rxOverruns;
+    }
+#else
+    overruns = rxOverruns;
+#endif
+    return overruns;
+}
+
+/**************************
+ * ATmega328 USART0
+ **************************/
+#if defined(__AVR__)
+
+void gps_uart_hw_begin(unsigned long baud) {
+    //double speed mode, as the Arduino core : 2.1% error at 115200 from 16MHz
+    uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+
+    UCSR0B = 0;
+    UCSR0A = _BV(U2X0);
+    UBRR0H = ubrr >> 8;
+    UBRR0L = ubrr & 0xFF;
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00); //8N1
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void gps_uart_hw_write(uint8_t c) {
+    while (!(UCSR0A & _BV(UDRE0))) {
+        ;
+    }
+    UDR0 = c;
+}
+
+ISR(USART_RX_vect) {
+    uint8_t status = UCSR0A;
+    uint8_t c = UDR0;
+    if (status & _BV(DOR0)) {
+        //the hardware already lost a byte before this one
+        rxOverruns++;
+    }
+    gps_uart_rx_byte(c);
+}
+
+#endif
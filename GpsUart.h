@@ -0,0 +1,59 @@
+/*
+ * GpsUart.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Interrupt driven reception of the GPS serial line (USART0).
+ *
+ *  Bytes are stored by the RX interrupt into a single producer / single
+ *  consumer ring, so they keep being received while the main loop is busy
+ *  (SD card writes...). The consumer side never disables interrupts as long
+ *  as the ring indexes fit in a byte.
+ *
+ *  This driver owns USART0 and its RX vector : the sketch must not use the
+ *  core Serial object (with Arduino >= 1.5, HardwareSerial0 is then not
+ *  linked and does not claim the vector).
+ *
+ */
+
+#ifndef GPSUART_H_
+#define GPSUART_H_
+
+#include "Arduino.h"
+
+/*
+ * Ring size, in bytes. Power of two. One 10Hz RMC+GGA epoch is ~150 bytes.
+ */
+#ifndef GPS_UART_RX_BUFFER_SIZE
+#define GPS_UART_RX_BUFFER_SIZE 256
+#endif
+
+#if (GPS_UART_RX_BUFFER_SIZE & (GPS_UART_RX_BUFFER_SIZE - 1)) != 0
+#error "GPS_UART_RX_BUFFER_SIZE must be a power of two"
+#endif
+
+void gps_uart_begin(unsigned long baud);
+
+// Next received byte, -1 if none.
+int gps_uart_read(void);
+
+uint16_t gps_uart_available(void);
+
+// Sends a command line, CR LF appended. Blocking.
+void gps_uart_println(const char* line);
+
+// Bytes lost since begin : ring full, or hardware overrun.
+uint16_t gps_uart_overruns(void);
+
+/*
+ * Hardware layer, implemented at the end of GpsUart.cpp for the AVR.
+ * Host builds provide their own (see host/hal/mock_hal.cpp).
+ */
+void gps_uart_hw_begin(unsigned long baud);
+void gps_uart_hw_write(uint8_t c);
+
+// Receive interrupt body : called for each received byte.
+void gps_uart_rx_byte(uint8_t c);
+
+#endif /* GPSUART_H_ */
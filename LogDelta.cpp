@@ -0,0 +1,244 @@
+/*
+ * LogDelta.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See LogDelta.h.
+ *
+ */
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "LogDelta.h"
+
+#define VARINT_MAX 5 // bytes of a 32 bits varint
+
+/***************************************************
+* DATA
+***************************************************/
+// widths of the fields after the tag, in record order
+static constexpr uint8_t gpsWidths[] PROGMEM = {
+    1, 1, 2, 4,                   // fix, sats, hdop_c, alt_cm
+    1, 1, 1, 1, 1, 1, 2,          // year to milliseconds
+    4, 4, 2, 2,                   // lat_e7, lon_e7, spd_ckn, heading_cdeg
+    2, 4, 4, 4,                   // temperature_dc, pressure_pa, hpa0_pa, baro_alt_cm
+    2, 4, 4,                      // pressure_count, pressure_min_pa, pressure_max_pa
+    4,                            // micros
+    4, 2                          // fused_alt_cm, vspeed_cms
+};
+static constexpr uint8_t baroWidths[] PROGMEM = { 4, 4, 4 }; // micros, pressure_pa, utc_dms
+
+#define GPS_FIELDS sizeof(gpsWidths)
+#define BARO_FIELDS sizeof(baroWidths)
+
+// Sum of the fields widths (compile time)
+static constexpr uint16_t widths_sum(const uint8_t* widths, uint8_t fields) {
+    return fields == 0 ? 0 : widths[0] + widths_sum(widths + 1, fields - 1);
+}
+
+static_assert(widths_sum(gpsWidths, GPS_FIELDS) == sizeof(logGpsRecord_t) - sizeof(logRecordTag_t),
+              "gpsWidths must cover logGpsRecord_t");
+static_assert(widths_sum(baroWidths, BARO_FIELDS) == sizeof(logBaroRecord_t) - sizeof(logRecordTag_t),
+              "baroWidths must cover logBaroRecord_t");
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+// Field of width bytes at p, little endian
+static uint32_t get_field(const uint8_t* p, uint8_t width) {
+    uint32_t value = 0;
+
+    while (width > 0) {
+        width--;
+        value = (value << 8) | p[width];
+    }
+    return value;
+}
+
+static void put_field(uint8_t* p, uint8_t width, uint32_t value) {
+    while (width > 0) {
+        *p++ = (uint8_t)value;
+        value >>= 8;
+        width--;
+    }
+}
+
+/*
+ * Varint of value at out, bounded by end : the byte after it, NULL if it
+ * does not fit.
+ */
+static uint8_t* put_varint(uint8_t* out, const uint8_t* end, uint32_t value) {
+    while (value >= 0x80) {
+        if (out == end) {
+            return NULL;
+        }
+        *out++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    if (out == end) {
+        return NULL;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Varint at in, bounded by end : the byte after it, NULL if truncated.
+static const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, uint32_t* value) {
+    uint8_t shift = 0;
+
+    *value = 0;
+    do {
+        if (in == end || shift >= 7 * VARINT_MAX) {
+            return NULL;
+        }
+        *value |= (uint32_t)(*in & 0x7F) << shift;
+        shift += 7;
+    } while (*in++ & 0x80);
+    return in;
+}
+
+/*
+ * Delta record of the fields of record against base (full records of
+ * size bytes) to out : its size, 0 if not shorter than size.
+ */
+static uint8_t encode(uint8_t type, const uint8_t* widths, uint8_t fields,
+                      const uint8_t* record, const uint8_t* base, uint8_t size, uint8_t* out) {
+    const uint8_t* end = out + size - 1; // shorter than size
+    uint32_t mask = 0;
+    uint8_t offset = sizeof(logRecordTag_t);
+    uint8_t* p;
+    uint8_t i;
+
+    for (i = 0; i < fields; i++) {
+        uint8_t width = pgm_read_byte(&widths[i]);
+        if (memcmp(&record[offset], &base[offset], width) != 0) {
+            mask |= (uint32_t)1 << i;
+        }
+        offset += width;
+    }
+
+    p = put_varint(out + sizeof(logRecordTag_t), end, mask);
+    offset = sizeof(logRecordTag_t);
+    for (i = 0; i < fields && p != NULL; i++) {
+        uint8_t width = pgm_read_byte(&widths[i]);
+        if (mask & ((uint32_t)1 << i)) {
+            uint8_t shift = 32 - 8 * width;
+            uint32_t delta = get_field(&record[offset], width) - get_field(&base[offset], width);
+            int32_t signedDelta = (int32_t)(delta << shift) >> shift;
+            p = put_varint(p, end, ((uint32_t)signedDelta << 1) ^ (uint32_t)(signedDelta >> 31));
+        }
+        offset += width;
+    }
+    if (p == NULL) {
+        return 0;
+    }
+    out[0] = type;
+    out[1] = p - out;
+    return p - out;
+}
+
+/*
+ * Full record of the delta record in (size bytes) on base, to base : false
+ * if inconsistent.
+ */
+static bool decode(const uint8_t* widths, uint8_t fields, const uint8_t* in, uint8_t size, uint8_t* base) {
+    const uint8_t* end = in + size;
+    uint32_t mask;
+    uint8_t offset = sizeof(logRecordTag_t);
+
+    in = get_varint(in + sizeof(logRecordTag_t), end, &mask);
+    for (uint8_t i = 0; i < fields && in != NULL; i++) {
+        uint8_t width = pgm_read_byte(&widths[i]);
+        if (mask & ((uint32_t)1 << i)) {
+            uint32_t zigzag;
+            in = get_varint(in, end, &zigzag);
+            if (in != NULL) {
+                uint32_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+                put_field(&base[offset], width, get_field(&base[offset], width) + delta);
+            }
+        }
+        offset += width;
+    }
+    return in == end;
+}
+
+void log_delta_reset(logDeltaState_t* state) {
+    state->gpsBase = false;
+    state->baroBase = false;
+}
+
+uint8_t log_delta_gps(logDeltaState_t* state, const logGpsRecord_t* record, uint8_t* out) {
+    uint8_t size = 0;
+
+    if (state->gpsBase && state->gpsDeltas < LOG_DELTA_KEYFRAME - 1) {
+        size = encode(LOG_REC_GPS_DELTA, gpsWidths, GPS_FIELDS, (const uint8_t*)record,
+                      (const uint8_t*)&state->gps, sizeof(*record), out);
+    }
+    if (size == 0) {
+        state->gpsDeltas = 0;
+        state->baroBase = false;
+    } else {
+        state->gpsDeltas++;
+    }
+    state->gps = *record;
+    state->gpsBase = true;
+    return size;
+}
+
+uint8_t log_delta_baro(logDeltaState_t* state, const logBaroRecord_t* record, uint8_t* out) {
+    uint8_t size = 0;
+
+    if (state->baroBase) {
+        size = encode(LOG_REC_BARO_DELTA, baroWidths, BARO_FIELDS, (const uint8_t*)record,
+                      (const uint8_t*)&state->baro, sizeof(*record), out);
+    }
+    state->baro = *record;
+    state->baroBase = true;
+    return size;
+}
+
+uint8_t log_delta_decode(logDeltaState_t* state, const uint8_t* record, uint8_t* out) {
+    logRecordTag_t tag;
+
+    memcpy(&tag, record, sizeof(tag));
+    switch (tag.type) {
+        case LOG_REC_HEADER:
+            log_delta_reset(state);
+            break;
+        case LOG_REC_GPS:
+            //older versions : the appended fields stay 0
+            memset(&state->gps, 0, sizeof(state->gps));
+            memcpy(&state->gps, record, tag.size < sizeof(state->gps) ? tag.size : sizeof(state->gps));
+            state->gpsBase = true;
+            break;
+        case LOG_REC_BARO:
+            state->baro.utc_dms = LOG_NO_UTC;
+            memcpy(&state->baro, record, tag.size < sizeof(state->baro) ? tag.size : sizeof(state->baro));
+            state->baroBase = true;
+            break;
+        case LOG_REC_GPS_DELTA:
+            if (!state->gpsBase || !decode(gpsWidths, GPS_FIELDS, record, tag.size, (uint8_t*)&state->gps)) {
+                return 0;
+            }
+            memcpy(out, &state->gps, sizeof(state->gps));
+            out[0] = LOG_REC_GPS;
+            out[1] = sizeof(state->gps);
+            return sizeof(state->gps);
+        case LOG_REC_BARO_DELTA:
+            if (!state->baroBase || !decode(baroWidths, BARO_FIELDS, record, tag.size, (uint8_t*)&state->baro)) {
+                return 0;
+            }
+            memcpy(out, &state->baro, sizeof(state->baro));
+            out[0] = LOG_REC_BARO;
+            out[1] = sizeof(state->baro);
+            return sizeof(state->baro);
+        default:
+            break;
+    }
+    memcpy(out, record, tag.size);
+    return tag.size;
+}
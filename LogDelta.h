@@ -0,0 +1,73 @@
+/*
+ * LogDelta.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  Delta records of the binary log (LOG_DELTA build of the logger) :
+ *  consecutive records differ by little in most of their fields, and not
+ *  at all in the others.
+ *
+ *  A delta record (LOG_REC_GPS_DELTA, LOG_REC_BARO_DELTA) is :
+ *   - its tag,
+ *   - a varint mask of the fields changed since the previous record of
+ *     the same kind, bit 0 for the first field after the tag,
+ *   - for each changed field, in record order, its difference with the
+ *     previous value, modulo the field width, as a zigzag varint.
+ *  Varints are little endian groups of 7 bits, the high bit set on all
+ *  but the last byte. Zigzag maps 0, -1, 1, -2... to 0, 1, 2, 3... so
+ *  that small differences of either sign take a byte or two.
+ *
+ *  A full record is a keyframe : every LOG_DELTA_KEYFRAME GPS records,
+ *  and after log_delta_reset() (new file, and the records a reader may
+ *  seek to, see LogSession.h). The first baro record after a GPS
+ *  keyframe is full too, so the log can be read from any keyframe on.
+ *  A delta that would not be shorter than the full record is not
+ *  written either.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef LOGDELTA_H_
+#define LOGDELTA_H_
+
+#include <stdint.h>
+
+#include "LogRecord.h"
+
+// GPS records from a keyframe to the next one
+#ifndef LOG_DELTA_KEYFRAME
+#define LOG_DELTA_KEYFRAME 16
+#endif
+
+// Longest record out of log_delta_decode()
+#define LOG_DELTA_FULL_MAX 255
+
+typedef struct {
+    logGpsRecord_t gps;     // previous records
+    logBaroRecord_t baro;
+    uint8_t gpsDeltas;      // since the last GPS keyframe
+    bool gpsBase;           // gps and baro hold a record
+    bool baroBase;
+} logDeltaState_t;
+
+// Next records full : to be called before the first one of a file.
+void log_delta_reset(logDeltaState_t* state);
+
+/*
+ * Encoding : the delta record of record to out (sizeof(*record) bytes),
+ * its size, or 0 if record is to be written as it is (keyframe).
+ */
+uint8_t log_delta_gps(logDeltaState_t* state, const logGpsRecord_t* record, uint8_t* out);
+uint8_t log_delta_baro(logDeltaState_t* state, const logBaroRecord_t* record, uint8_t* out);
+
+/*
+ * Decoding : the record at record (any type, its tag.size bytes) to out
+ * (LOG_DELTA_FULL_MAX bytes), delta records turned back into full ones,
+ * the others copied. Its size in out, 0 for a delta record without its
+ * base (read from the middle of a log) or inconsistent.
+ */
+uint8_t log_delta_decode(logDeltaState_t* state, const uint8_t* record, uint8_t* out);
+
+#endif /* LOGDELTA_H_ */
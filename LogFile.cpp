@@ -0,0 +1,463 @@
+/*
+ * LogFile.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See LogFile.h.
+ *
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "LogFile.h"
+
+#if LOG_RAW
+#if LOG_SECTOR_SIZE != LOG_FRAME_SIZE
+#error "LOG_RAW writes card blocks : LOG_SECTOR_SIZE must be LOG_FRAME_SIZE"
+#endif
+#define DATA_OFFSET sizeof(logFrameHeader_t) // of the payload in the buffers
+#define NO_RESTART 0xFFFFFFFFUL
+#else
+#define DATA_OFFSET 0
+#endif
+
+/***************************************************
+* DATA
+***************************************************/
+LogFile logFile;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+#if LOG_RAW
+/*
+ * The two digits before the dot moved up. False after 99, or without them.
+ */
+static boolean next_name(char* path) {
+    char* dot = strrchr(path, '.');
+
+    if (dot == NULL || dot - path < 2 || !isdigit(dot[-1]) || !isdigit(dot[-2])) {
+        return false;
+    }
+    if (dot[-1] < '9') {
+        dot[-1]++;
+    } else if (dot[-2] < '9') {
+        dot[-1] = '0';
+        dot[-2]++;
+    } else {
+        return false;
+    }
+    return true;
+}
+#endif
+
+boolean LogFile::begin(const char* path) {
+    memset(lengths, 0, sizeof(lengths));
+    filling = 0;
+    queued = 0;
+    unsynced = false;
+    flushPending = false;
+#if LOG_RAW
+    if (strlen(path) >= sizeof(rawPath)) {
+        return false;
+    }
+    strcpy(rawPath, path);
+    if (!log_raw_hw_begin(rawPath)) {
+        return false;
+    }
+    for (;;) {
+        if (log_raw_hw_open(rawPath, &rawFirst, &rawBlocks)) {
+            if (rawBlocks == LOG_RAW_SIZE / LOG_SECTOR_SIZE && recover()) {
+                break;
+            }
+            log_raw_hw_close(); //full, or not a LOG_RAW file
+        } else if (log_raw_hw_create(rawPath, LOG_RAW_SIZE, &rawFirst)) {
+            rawBlocks = LOG_RAW_SIZE / LOG_SECTOR_SIZE;
+            rawIndex = 0;
+            restartIndex = NO_RESTART;
+            break;
+        }
+        if (!next_name(rawPath)) {
+            return false;
+        }
+    }
+    streaming = false;
+    limit = LOG_FRAME_PAYLOAD;
+#else
+    closingQueued = 0;
+    file = SD.open(path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    position = file.size();
+    limit = LOG_SECTOR_SIZE - position % LOG_SECTOR_SIZE;
+#endif
+    return true;
+}
+
+#if !LOG_RAW
+/*
+ * The buffered end of the current file stays queued for it : the partial
+ * filling buffer is queued as it is, and the next bytes go to path.
+ */
+boolean LogFile::rotate(const char* path) {
+    File next;
+
+    if (closing) {
+        //the previous rotation is not over : finished now
+        while (closingQueued > 0) {
+            write_oldest();
+        }
+        closing.close();
+    }
+    next = SD.open(path, FILE_WRITE);
+    if (!next) {
+        return false;
+    }
+    closing = file;
+    if (lengths[filling] > 0) {
+        queued++;
+        filling = (filling + 1) % LOG_BUFFER_COUNT;
+    }
+    closingQueued = queued;
+    file = next;
+    if (queued == LOG_BUFFER_COUNT) {
+        write_oldest(); //no buffer left to fill
+    }
+    lengths[filling] = 0;
+    position = file.size();
+    limit = LOG_SECTOR_SIZE - position % LOG_SECTOR_SIZE;
+    unsynced = false;
+    flushPending = false; //of the closing file : its close() does it
+    return true;
+}
+#endif
+
+#if LOG_RAW
+/*
+ * True if block is as erased : all 0x00 or all 0xFF (depends on the card).
+ */
+static boolean erased(const uint8_t* block) {
+    if (block[0] != 0x00 && block[0] != 0xFF) {
+        return false;
+    }
+    for (uint16_t i = 1; i < LOG_SECTOR_SIZE; i++) {
+        if (block[i] != block[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Where writing goes on in the file just opened : after the last valid
+ * frame, or in it if it has room (it is then loaded in the first buffer).
+ * The frames being valid up to some block and not after, that block is
+ * found by a binary search. False if the file is full, or is not a LOG_RAW
+ * file (its first block neither a frame nor erased, e.g. a FAT log that
+ * happens to be contiguous) : it is left as it is.
+ */
+boolean LogFile::recover(void) {
+    uint8_t* frame = buffers[0];
+    uint32_t low = 0;            // frames before it are valid...
+    uint32_t high = rawBlocks;   // ...this one is not
+    logFrameHeader_t header;
+
+    log_raw_hw_read_block(rawFirst, frame);
+    if (!log_frame_valid(frame, 0) && !erased(frame)) {
+        return false;
+    }
+    //a full file is told by its last block
+    log_raw_hw_read_block(rawFirst + rawBlocks - 1, frame);
+    if (log_frame_valid(frame, rawBlocks - 1)) {
+        low = rawBlocks;
+    } else {
+        high = rawBlocks - 1;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            log_raw_hw_read_block(rawFirst + middle, frame);
+            if (log_frame_valid(frame, middle)) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+    }
+
+    restartIndex = NO_RESTART;
+    if (low == 0) {
+        rawIndex = 0;
+        return true;
+    }
+    log_raw_hw_read_block(rawFirst + low - 1, frame);
+    memcpy(&header, frame, sizeof(header));
+    if (header.length < LOG_FRAME_PAYLOAD) {
+        rawIndex = low - 1;
+        lengths[0] = header.length;
+        if (header.flags & LOG_FRAME_RESTART) {
+            restartIndex = rawIndex;
+        }
+        return true;
+    }
+    if (low == rawBlocks) {
+        return false;
+    }
+    //the last frame may end inside a record
+    rawIndex = low;
+    restartIndex = low;
+    return true;
+}
+
+void LogFile::seal(uint8_t* frame, uint16_t length) {
+    log_frame_seal(frame, rawIndex, length, rawIndex == restartIndex ? LOG_FRAME_RESTART : 0);
+}
+#endif
+
+size_t LogFile::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t LogFile::write(const uint8_t* buf, size_t size) {
+    size_t left = size;
+
+    if (size > 0 && !unsynced) {
+        unsynced = true;
+        unsyncedSince = millis();
+    }
+    while (left > 0) {
+        uint16_t room = limit - lengths[filling];
+        if (room == 0) {
+            queue_filling();
+            continue;
+        }
+        if (room > left) {
+            room = left;
+        }
+        memcpy(&buffers[filling][DATA_OFFSET + lengths[filling]], buf, room);
+        lengths[filling] += room;
+        buf += room;
+        left -= room;
+    }
+    return size;
+}
+
+/*
+ * The filling buffer is full : queues it and moves to the next one.
+ * If that one is still queued (all buffers full), it is written right now.
+ */
+void LogFile::queue_filling(void) {
+    queued++;
+#if !LOG_RAW
+    position += lengths[filling];
+#endif
+    filling = (filling + 1) % LOG_BUFFER_COUNT;
+    if (queued == LOG_BUFFER_COUNT) {
+        write_oldest();
+    }
+    lengths[filling] = 0;
+#if !LOG_RAW
+    limit = LOG_SECTOR_SIZE - position % LOG_SECTOR_SIZE;
+#endif
+}
+
+void LogFile::write_oldest(void) {
+    uint8_t oldest = (filling + LOG_BUFFER_COUNT - queued) % LOG_BUFFER_COUNT;
+#if LOG_RAW
+    if (rawIndex < rawBlocks) { //else the file is full : lost
+        seal(buffers[oldest], lengths[oldest]);
+        if (!streaming) {
+            log_raw_hw_write_start(rawFirst + rawIndex, rawBlocks - rawIndex);
+            streaming = true;
+        }
+        log_raw_hw_write_data(buffers[oldest]);
+        rawIndex++;
+    }
+#else
+    if (closingQueued > 0) {
+        closing.write(buffers[oldest], lengths[oldest]);
+        closingQueued--;
+    } else {
+        file.write(buffers[oldest], lengths[oldest]);
+    }
+#endif
+    queued--;
+}
+
+/*
+ * Writes the filling buffer as it is, the next one ending on a sector
+ * boundary. Its bytes are covered by the next flush.
+ * LOG_RAW : the frame is written padded, and the buffer goes on filling,
+ * to be written again on the same block. No multi-block write must be open.
+ */
+void LogFile::write_partial(void) {
+#if LOG_RAW
+    if (lengths[filling] > 0 && rawIndex < rawBlocks) {
+        memset(&buffers[filling][DATA_OFFSET + lengths[filling]], 0, LOG_FRAME_PAYLOAD - lengths[filling]);
+        seal(buffers[filling], lengths[filling]);
+        log_raw_hw_write_block(rawFirst + rawIndex, buffers[filling]);
+    }
+#else
+    if (lengths[filling] > 0) {
+        file.write(buffers[filling], lengths[filling]);
+        position += lengths[filling];
+        lengths[filling] = 0;
+        limit = LOG_SECTOR_SIZE - position % LOG_SECTOR_SIZE;
+    }
+#endif
+    unsynced = false;
+}
+
+/*
+ * Directory entry update. LOG_RAW : end of the multi-block write instead.
+ */
+void LogFile::flush_card(void) {
+#if LOG_RAW
+    if (streaming) {
+        log_raw_hw_write_stop();
+        streaming = false;
+    }
+#else
+    file.flush();
+#endif
+}
+
+boolean LogFile::service(void) {
+    if (queued > 0) {
+        write_oldest();
+#if !LOG_RAW
+    } else if (closing) {
+        closing.close();
+#endif
+    } else if (flushPending) {
+        flush_card();
+        flushPending = false;
+    } else if (unsynced && millis() - unsyncedSince >= LOG_SYNC_MS) {
+#if LOG_RAW
+        if (streaming) {
+            flush_card(); //the partial block comes on the next call
+            return true;
+        }
+        write_partial();
+#else
+        write_partial();
+        flushPending = true;
+#endif
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void LogFile::sync(void) {
+    while (queued > 0) {
+        write_oldest();
+    }
+#if LOG_RAW
+    flush_card();
+    write_partial();
+#else
+    if (closing) {
+        closing.close();
+    }
+    write_partial();
+    file.flush();
+#endif
+    flushPending = false;
+}
+
+void LogFile::close(void) {
+    sync();
+#if LOG_RAW
+    log_raw_hw_close();
+#else
+    file.close();
+#endif
+}
+
+/**************************
+ * LOG_RAW on the AVR : the SdFat classes the SD library is built on, with a
+ * card and a volume of their own, set up again after SD.begin().
+ **************************/
+#if defined(__AVR__) && LOG_RAW
+
+static Sd2Card rawCard;
+static SdVolume rawVolume;
+static SdFile rawFolder;   // of the path of begin(), the names move up in it
+static SdFile rawFile;
+
+// Name of path in its folder (FOLDER/NAME).
+static const char* name_of(const char* path) {
+    return strchr(path, '/') + 1;
+}
+
+boolean log_raw_hw_begin(const char* path) {
+    SdFile root;
+    char folder[13];
+    const char* slash = strchr(path, '/');
+
+    if (slash == NULL || slash - path >= (int)sizeof(folder)) {
+        return false;
+    }
+    memcpy(folder, path, slash - path);
+    folder[slash - path] = '\0';
+    rawFolder.close();
+    return rawCard.init(SPI_FULL_SPEED) && rawVolume.init(&rawCard) && root.openRoot(&rawVolume)
+           && rawFolder.open(&root, folder, O_READ);
+}
+
+boolean log_raw_hw_create(const char* path, uint32_t size, uint32_t* firstBlock) {
+    const char* name = name_of(path);
+    uint32_t lastBlock;
+
+    if (rawFile.open(&rawFolder, name, O_READ)) {
+        rawFile.close();
+        return false;
+    }
+    //FAT chain and directory entry written there, once
+    return rawFile.createContiguous(&rawFolder, name, size) && rawFile.contiguousRange(firstBlock, &lastBlock)
+           && rawCard.erase(*firstBlock, lastBlock);
+}
+
+boolean log_raw_hw_open(const char* path, uint32_t* firstBlock, uint32_t* blocks) {
+    uint32_t lastBlock;
+
+    if (!rawFile.open(&rawFolder, name_of(path), O_READ)) {
+        return false;
+    }
+    if (!rawFile.contiguousRange(firstBlock, &lastBlock)) {
+        rawFile.close();
+        return false;
+    }
+    *blocks = lastBlock - *firstBlock + 1;
+    return true;
+}
+
+void log_raw_hw_read_block(uint32_t block, uint8_t* data) {
+    rawCard.readBlock(block, data);
+}
+
+void log_raw_hw_write_start(uint32_t block, uint32_t count) {
+    rawCard.writeStart(block, count);
+}
+
+void log_raw_hw_write_data(const uint8_t* data) {
+    rawCard.writeData(data);
+}
+
+void log_raw_hw_write_stop(void) {
+    rawCard.writeStop();
+}
+
+void log_raw_hw_write_block(uint32_t block, const uint8_t* data) {
+    rawCard.writeBlock(block, data);
+}
+
+void log_raw_hw_close(void) {
+    rawFile.close();
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * LogFile.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Log file kept open for the whole session, written by whole sectors.
+ *
+ *  Records are printed into RAM sector buffers. A full buffer is queued and
+ *  written by service() on a later loop pass, while the next one fills. The
+ *  card is only touched :
+ *   - when a sector is full : one aligned 512 bytes write, which the SD
+ *     library sends to the card without going through its block cache,
+ *   - when the oldest unsynced byte is LOG_SYNC_MS old : the partial sector
+ *     is written and the directory entry updated (file size), so a power
+ *     loss costs at most LOG_SYNC_MS of records, plus a loop pass.
+ *  service() does one card operation per call, a sync taking two calls :
+ *  loop() stays responsive between them.
+ *  After a partial write the next buffer is shortened to end on a sector
+ *  boundary, so the following writes are aligned again.
+ *
+ *  RAM : LOG_BUFFER_COUNT * LOG_SECTOR_SIZE, on top of the 512 bytes cache
+ *  of the SD library. With a single buffer, a full sector is written as
+ *  soon as the next byte arrives (no overlap).
+ *
+ *  With LOG_RAW, the FAT layer is left out while logging : the file is one
+ *  contiguous extent of LOG_RAW_SIZE bytes, created and erased once, and
+ *  each sector goes straight to its card block, as one multi-block write.
+ *  Neither the FAT nor the directory entry is written after the creation :
+ *  the file keeps its size, and the end of the data is told by the frames
+ *  of LogFrame.h, each sector holding LOG_FRAME_PAYLOAD bytes of the log.
+ *  A sync writes the partial frame as a single block, which the
+ *  multi-block write restarted on it overwrites once full.
+ *  begin() finds the last valid frame of an existing file by a binary
+ *  search (about 16 block reads for 32 MB, whatever the card holds) and
+ *  goes on from there : in that frame if it has room, else in the next
+ *  one, flagged LOG_FRAME_RESTART.
+ *
+ */
+
+#ifndef LOGFILE_H_
+#define LOGFILE_H_
+
+#include "Arduino.h"
+#include "LogFrame.h"
+#include "SD.h"
+
+#ifndef LOG_SECTOR_SIZE
+#define LOG_SECTOR_SIZE 512
+#endif
+
+/*
+ * Sector buffers : with 2, one fills while the other is written. On the
+ * ATmega328 they are half of its 2 kB ; the constant tables are in flash
+ * (PowersOf10.h, logTextColumns) to leave room for the stack. Check the
+ * RAM high-water mark of avrbench/ when adding data.
+ */
+#ifndef LOG_BUFFER_COUNT
+#define LOG_BUFFER_COUNT 2
+#endif
+
+/*
+ * Max age of data not yet in the file size on the card, in ms.
+ */
+#ifndef LOG_SYNC_MS
+#define LOG_SYNC_MS 10000
+#endif
+
+/*
+ * LOG_RAW 1 : contiguous preallocated file of frames, written by raw blocks.
+ * When the file of the path is full, or was not created by LOG_RAW (not
+ * LOG_RAW_SIZE bytes, or its first block neither a frame nor erased), the
+ * two digits before its dot are moved up : HZ1_02.bin, HZ1_03.bin...
+ */
+#ifndef LOG_RAW
+#define LOG_RAW 0
+#endif
+
+#ifndef LOG_RAW_SIZE
+#define LOG_RAW_SIZE 33554432UL // 32 MB : 9 hours of baro records
+#endif
+
+class LogFile : public Print {
+private:
+#if LOG_RAW
+    uint32_t rawFirst;    // card block of the start of the file
+    uint32_t rawBlocks;   // blocks of the file
+    uint32_t rawIndex;    // file block of the oldest buffer not written
+    uint32_t restartIndex; // file block flagged LOG_FRAME_RESTART
+    boolean streaming;    // multi-block write open on rawIndex
+    char rawPath[24];
+#else
+    File file;
+    uint32_t position;    // file offset of the filling buffer
+    File closing;         // previous file of rotate(), until written and closed
+    uint8_t closingQueued; // the oldest queued buffers, its end
+#endif
+    uint8_t buffers[LOG_BUFFER_COUNT][LOG_SECTOR_SIZE];
+    uint16_t lengths[LOG_BUFFER_COUNT];
+    uint16_t limit;       // end of the filling buffer, on a sector boundary (frame payload)
+    uint8_t filling;      // buffer being printed into
+    uint8_t queued;       // full buffers waiting for service(), before filling
+    boolean unsynced;     // bytes not yet covered by the directory entry
+    unsigned long unsyncedSince;
+    boolean flushPending; // partial sector written, directory entry not yet
+
+    void write_partial(void);
+    void queue_filling(void);
+    void write_oldest(void);
+    void flush_card(void);
+#if LOG_RAW
+    boolean recover(void);
+    void seal(uint8_t* frame, uint16_t length);
+#endif
+
+public:
+    /*
+     * Opens path for appending, and keeps it open (LOG_RAW : see above).
+     * False if it can't be opened.
+     */
+    boolean begin(const char* path);
+#if LOG_RAW
+    // Path of the file begin() opened.
+    const char* path(void) { return rawPath; }
+#else
+    // Bytes of the file, buffered ones included.
+    uint32_t size(void) { return position + lengths[filling]; }
+
+    /*
+     * Goes on in path, opened for appending : one card operation. The
+     * current file gets its buffered end written and is closed by the next
+     * service() calls. False if path can't be opened : the current file
+     * goes on.
+     */
+    boolean rotate(const char* path);
+#endif
+
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t* buf, size_t size);
+    using Print::write;
+
+    /*
+     * To be called on loop passes with nothing else to do : one card
+     * operation at most, writing a queued sector, closing the file left
+     * by rotate(), or the partial sector then the directory entry when
+     * LOG_SYNC_MS expired. False if there was nothing to do.
+     */
+    boolean service(void);
+
+    // Writes everything buffered and updates the directory entry. Blocking.
+    void sync(void);
+
+    // End of session : sync(), then the file is closed. Blocking.
+    void close(void);
+};
+
+extern LogFile logFile;
+
+/*
+ * Card layer of LOG_RAW, implemented at the end of LogFile.cpp for the AVR
+ * (the SdFat classes under the SD library). Host builds provide their own
+ * (see host/hal/mock_sd.cpp).
+ */
+// Card, volume and folder of path set up for the calls that follow, once per LogFile::begin().
+boolean log_raw_hw_begin(const char* path);
+// Creates path, contiguous and erased, size bytes : its first block to *firstBlock. False if it exists.
+boolean log_raw_hw_create(const char* path, uint32_t size, uint32_t* firstBlock);
+// Opens path if it is contiguous : its first block and its size in blocks.
+boolean log_raw_hw_open(const char* path, uint32_t* firstBlock, uint32_t* blocks);
+void log_raw_hw_read_block(uint32_t block, uint8_t* data);
+// Multi-block write from block on, count blocks at most (pre-erased).
+void log_raw_hw_write_start(uint32_t block, uint32_t count);
+void log_raw_hw_write_data(const uint8_t* data);
+void log_raw_hw_write_stop(void);
+// Single block write, out of a multi-block one.
+void log_raw_hw_write_block(uint32_t block, const uint8_t* data);
+void log_raw_hw_close(void);
+
+#endif /* LOGFILE_H_ */
@@ -0,0 +1,168 @@
+/*
+ * LogFormat.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See LogFormat.h.
+ *
+ */
+
+#include "LogFormat.h"
+#include "PowersOf10.h"
+
+/***************************************************
+* DATA
+***************************************************/
+const char logTextColumns[] PROGMEM = "Fix|sats|HDOP|alt(m)|Date|Time|lat|Long|Spd(kmh)|Head|temp|hpa|hpa0|alt|n|hpa min|hpa max|us|falt|vz|";
+
+#define MAX_DIGITS POWERS_OF_10
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+/*
+ * Writes value in decimal, with at least minDigits digits (zero padded) and
+ * a point before the last `decimals` ones. Digits are found by subtracting
+ * powers of ten : no 32 bits division, which is a library call on the AVR.
+ * Returns the end of the written text.
+ */
+static char* put_unsigned(char* p, uint32_t value, uint8_t minDigits, uint8_t decimals) {
+    uint8_t started = 0;
+    uint8_t i;
+
+    for (i = 0; i < MAX_DIGITS; i++) {
+        uint8_t left = MAX_DIGITS - i;
+        uint32_t power = power_of_10(left - 1);
+        char digit = '0';
+
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        if (digit != '0' || left <= minDigits || left <= decimals + 1) {
+            started = 1;
+        }
+        if (started) {
+            if (left == decimals) {
+                *p++ = '.';
+            }
+            *p++ = digit;
+        }
+    }
+    return p;
+}
+
+static char* put_signed(char* p, int32_t value, uint8_t decimals) {
+    if (value < 0) {
+        *p++ = '-';
+        return put_unsigned(p, -(uint32_t)value, 1, decimals);
+    }
+    return put_unsigned(p, value, 1, decimals);
+}
+
+static char* put_field(char* p, int32_t value, uint8_t decimals) {
+    p = put_signed(p, value, decimals);
+    *p++ = LOG_TEXT_SEPARATOR;
+    return p;
+}
+
+/*
+ * 1/100 knots to 1/100 km/h, rounded : (ckn * 1852 + 500) / 1000 without
+ * the division. ckn * 1.852 in Q15 falls short by 2 at most, made up from
+ * the remainder.
+ */
+static uint32_t ckn_to_ckmh(uint16_t ckn) {
+    uint32_t ckmh = ((uint32_t)ckn * 60686) >> 15;
+    uint32_t rest = (uint32_t)ckn * 1852 + 500 - ckmh * 1000;
+
+    while (rest >= 1000) {
+        rest -= 1000;
+        ckmh++;
+    }
+    return ckmh;
+}
+
+uint8_t log_format_gps(char* out, const logGpsRecord_t* record) {
+    char* p = out;
+
+    //GGA
+    p = put_field(p, record->fix, 0);
+    p = put_field(p, record->sats, 0);
+    p = put_field(p, record->hdop_c, 2);
+    p = put_field(p, record->alt_cm, 2);
+    //RMC
+    *p++ = '2';
+    *p++ = '0';
+    p = put_unsigned(p, record->year, 2, 0);
+    p = put_unsigned(p, record->month, 2, 0);
+    p = put_unsigned(p, record->day, 2, 0);
+    *p++ = LOG_TEXT_SEPARATOR;
+    p = put_unsigned(p, record->hour, 2, 0);
+    p = put_unsigned(p, record->minute, 2, 0);
+    p = put_unsigned(p, record->seconds, 2, 0);
+    *p++ = '.';
+    p = put_unsigned(p, record->milliseconds, 3, 0);
+    *p++ = LOG_TEXT_SEPARATOR;
+    p = put_field(p, record->lat_e7, 7);
+    p = put_field(p, record->lon_e7, 7);
+    p = put_field(p, ckn_to_ckmh(record->spd_ckn), 2); //to kmh
+    p = put_field(p, record->heading_cdeg, 2);
+    //BMP
+    p = put_field(p, record->temperature_dc, 1);
+    p = put_field(p, record->pressure_pa, 0);
+    p = put_field(p, record->hpa0_pa, 0);
+    p = put_field(p, record->baro_alt_cm, 2);
+    p = put_field(p, record->pressure_count, 0);
+    p = put_field(p, record->pressure_min_pa, 0);
+    p = put_field(p, record->pressure_max_pa, 0);
+    p = put_unsigned(p, record->micros, 1, 0);
+    *p++ = LOG_TEXT_SEPARATOR;
+    //Fusion
+    p = put_field(p, record->fused_alt_cm, 2);
+    p = put_field(p, record->vspeed_cms, 2); //m/s
+
+    *p++ = '\r';
+    *p++ = '\n';
+    return p - out;
+}
+
+/*
+ * Writes a time of day in 1/10 ms as HHMMSS.ssss, by subtractions as well.
+ */
+static char* put_time_dms(char* p, uint32_t dms) {
+    static const uint32_t units[] = { 36000000UL, 600000UL, 10000UL };
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        uint8_t count = 0;
+
+        while (dms >= units[i]) {
+            dms -= units[i];
+            count++;
+        }
+        p = put_unsigned(p, count, 2, 0);
+    }
+    *p++ = '.';
+    return put_unsigned(p, dms, 4, 0);
+}
+
+uint8_t log_format_baro(char* out, const logBaroRecord_t* record) {
+    char* p = out;
+
+    *p++ = LOG_TEXT_BARO;
+    *p++ = LOG_TEXT_SEPARATOR;
+    p = put_unsigned(p, record->micros, 1, 0);
+    *p++ = LOG_TEXT_SEPARATOR;
+    p = put_field(p, record->pressure_pa, 0);
+    if (record->utc_dms != LOG_NO_UTC) {
+        p = put_time_dms(p, record->utc_dms);
+    }
+    *p++ = LOG_TEXT_SEPARATOR;
+
+    *p++ = '\r';
+    *p++ = '\n';
+    return p - out;
+}
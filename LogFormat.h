@@ -0,0 +1,50 @@
+/*
+ * LogFormat.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Text (CSV) rendering of the log records of LogRecord.h.
+ *
+ *  A whole line is built into a caller buffer with integer digit
+ *  conversion only (no Print, no float) : fixed decimals for each column,
+ *  zero padded date and time (YYYYMMDD, HHMMSS.mmm). The logger then writes
+ *  it in one call, and host/logdecode renders binary logs with the same
+ *  code, so both modes give the same text.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef LOGFORMAT_H_
+#define LOGFORMAT_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "LogRecord.h"
+
+#define LOG_TEXT_SEPARATOR '|'
+
+// First field of the baro lines, "B|us|hpa|utc|", mixed with the GPS ones.
+// utc is HHMMSS.ssss, empty without PPS.
+#define LOG_TEXT_BARO 'B'
+
+/*
+ * Longest line, CR LF included, for the widest value of every field.
+ */
+#define LOG_TEXT_MAX 206
+
+// Column names line, NUL terminated, without CR LF. In flash.
+extern const char logTextColumns[] PROGMEM;
+
+/*
+ * Renders record as a CSV line ended by CR LF, into out (LOG_TEXT_MAX bytes
+ * at least). Returns the line length. No NUL is added.
+ */
+uint8_t log_format_gps(char* out, const logGpsRecord_t* record);
+
+// Same for a baro record.
+uint8_t log_format_baro(char* out, const logBaroRecord_t* record);
+
+#endif /* LOGFORMAT_H_ */
@@ -0,0 +1,66 @@
+/*
+ * LogFrame.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See LogFrame.h.
+ *
+ */
+
+#include <string.h>
+
+#include "LogFrame.h"
+
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+static uint16_t crc_update(uint16_t crc, uint8_t data) {
+#if defined(__AVR__)
+    return _crc_ccitt_update(crc, data);
+#else
+    //the C equivalent given by avr-libc
+    data ^= crc & 0xFF;
+    data ^= data << 4;
+    return (((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3);
+#endif
+}
+
+static uint16_t frame_crc(const uint8_t* frame) {
+    uint16_t crc = 0xFFFF;
+
+    for (uint16_t i = 0; i < LOG_FRAME_SIZE - sizeof(uint16_t); i++) {
+        crc = crc_update(crc, frame[i]);
+    }
+    return crc;
+}
+
+void log_frame_seal(uint8_t* frame, uint32_t seq, uint16_t length, uint8_t flags) {
+    logFrameHeader_t header;
+    uint16_t crc;
+
+    header.magic = LOG_FRAME_MAGIC;
+    header.seq = seq;
+    header.length = length;
+    header.flags = flags;
+    memcpy(frame, &header, sizeof(header));
+    crc = frame_crc(frame);
+    memcpy(&frame[LOG_FRAME_SIZE - sizeof(crc)], &crc, sizeof(crc));
+}
+
+bool log_frame_valid(const uint8_t* frame, uint32_t seq) {
+    logFrameHeader_t header;
+    uint16_t crc;
+
+    memcpy(&header, frame, sizeof(header));
+    if (header.magic != LOG_FRAME_MAGIC || header.seq != seq || header.length > LOG_FRAME_PAYLOAD) {
+        return false;
+    }
+    memcpy(&crc, &frame[LOG_FRAME_SIZE - sizeof(crc)], sizeof(crc));
+    return crc == frame_crc(frame);
+}
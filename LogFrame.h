@@ -0,0 +1,55 @@
+/*
+ * LogFrame.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  Block framing of the LOG_RAW log file (LogFile.h), so that the end of
+ *  the data can be found again after a power cut.
+ *
+ *  Each 512 bytes card block of the file is a frame : a header, up to
+ *  LOG_FRAME_PAYLOAD bytes of the log stream, then a CRC-16 (CCITT, as
+ *  avr-libc's _crc_ccitt_update) of everything before it. A frame is valid
+ *  if its magic, its CRC, and its sequence number (its block index in the
+ *  file) all match. The file is erased when created, and written in
+ *  order : the valid frames are a prefix of the file, whose end is found
+ *  by a binary search. A block torn by a power cut fails its CRC, so the
+ *  loss is bounded to that block and the bytes not yet written.
+ *  The payloads of the valid frames, put back together, are the log
+ *  stream. A frame with LOG_FRAME_RESTART starts the stream again after a
+ *  power cut : the bytes before it may end in the middle of a record.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef LOGFRAME_H_
+#define LOGFRAME_H_
+
+#include <stdint.h>
+
+#define LOG_FRAME_SIZE 512
+#define LOG_FRAME_MAGIC 0x4C47 // "GL"
+
+// flags
+#define LOG_FRAME_RESTART 0x01
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint32_t seq;    // block index in the file
+    uint16_t length; // payload bytes
+    uint8_t flags;
+} logFrameHeader_t;
+
+#define LOG_FRAME_PAYLOAD (LOG_FRAME_SIZE - sizeof(logFrameHeader_t) - sizeof(uint16_t))
+
+/*
+ * Fills the header and the CRC of frame, whose payload holds length
+ * bytes (the rest of it is part of the CRC as it is).
+ */
+void log_frame_seal(uint8_t* frame, uint32_t seq, uint16_t length, uint8_t flags);
+
+// True if frame is a valid frame for block seq of the file.
+bool log_frame_valid(const uint8_t* frame, uint32_t seq);
+
+#endif /* LOGFRAME_H_ */
@@ -0,0 +1,111 @@
+/*
+ * LogRecord.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Binary log format (LOG_BINARY build of the logger).
+ *
+ *  The file is a sequence of packed records, little endian (AVR and x86
+ *  alike), each one starting with its type and its size in bytes :
+ *   - a header record at each boot, holding the format version,
+ *   - a GPS record per fix, with the BMP085 values of that moment and the
+ *     fused altitude,
+ *   - optionally (LOG_BARO_RECORDS build), a baro record per BMP085 sample,
+ *   - in a LOG_DELTA build, most GPS and baro records as delta records
+ *     instead, the differences with the previous record (LogDelta.h).
+ *  GPS and baro records carry micros() : both streams share that time
+ *  base, and the GPS records map it to UTC (it wraps every 71 minutes,
+ *  readers work with differences between close records). A logger with
+ *  a PPS input (GPS_PPS build) also stamps the baro records in UTC.
+ *  A reader skips the record types it does not know, using the size. A
+ *  newer version may only append fields at the end of an existing record.
+ *
+ *  All values are integers : no float formatting on the board, and no
+ *  rounding in the file beyond the sensor resolution.
+ *  host/logdecode turns a file back into CSV.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef LOGRECORD_H_
+#define LOGRECORD_H_
+
+#include <stdint.h>
+
+#define LOG_MAGIC "GLOG"
+#define LOG_VERSION 6 // 2 : pressure interval statistics, 3 : micros, baro records,
+                      // 4 : fused altitude, 5 : baro UTC, 6 : delta records
+
+typedef enum {
+    LOG_REC_HEADER     = 0x00,
+    LOG_REC_GPS        = 0x01,
+    LOG_REC_BARO       = 0x02,
+    LOG_REC_GPS_DELTA  = 0x03,
+    LOG_REC_BARO_DELTA = 0x04
+} logRecordType_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type; // logRecordType_t
+    uint8_t size; // of the whole record, type and size included
+} logRecordTag_t;
+
+typedef struct __attribute__((packed)) {
+    logRecordTag_t tag;
+    char magic[4];        // LOG_MAGIC, no NUL
+    uint8_t version;      // LOG_VERSION
+} logHeaderRecord_t;
+
+typedef struct __attribute__((packed)) {
+    logRecordTag_t tag;
+    //GGA
+    uint8_t fix;
+    uint8_t sats;
+    uint16_t hdop_c;       // 1/100
+    int32_t alt_cm;
+    //RMC
+    uint8_t year;          // from 2000
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t seconds;
+    uint16_t milliseconds;
+    int32_t lat_e7;        // 1e-7 degrees
+    int32_t lon_e7;        // 1e-7 degrees
+    uint16_t spd_ckn;      // 1/100 knots
+    uint16_t heading_cdeg; // 1/100 degrees
+    //BMP085
+    int16_t temperature_dc; // 1/10 degC
+    int32_t pressure_pa;    // filtered (PressureFilter.h)
+    int32_t hpa0_pa;
+    int32_t baro_alt_cm;    // of pressure_pa
+    //version 2 : pressure samples since the previous record
+    uint16_t pressure_count;
+    int32_t pressure_min_pa;
+    int32_t pressure_max_pa;
+    //version 3
+    uint32_t micros;        // when the fix was received
+    //version 4 : GPS / baro fusion (AltitudeFusion.h), hpa0_pa is its estimate
+    int32_t fused_alt_cm;
+    int16_t vspeed_cms;     // up is positive
+} logGpsRecord_t;
+
+typedef struct __attribute__((packed)) {
+    logRecordTag_t tag;
+    uint32_t micros;        // end of the pressure conversion
+    int32_t pressure_pa;    // unfiltered
+    //version 5
+    uint32_t utc_dms;       // of micros, 1/10 ms since midnight (Pps.h), or LOG_NO_UTC
+} logBaroRecord_t;
+
+// utc_dms of a sample taken without PPS
+#define LOG_NO_UTC 0xFFFFFFFFUL
+
+// Size of a version 1 GPS record, without the fields appended since.
+#define LOG_GPS_RECORD_V1_SIZE 44
+// Same for a version 3 baro record.
+#define LOG_BARO_RECORD_V3_SIZE 10
+
+#endif /* LOGRECORD_H_ */
@@ -0,0 +1,385 @@
+/*
+ * LogSession.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See LogSession.h.
+ *
+ */
+
+#include <string.h>
+
+#include "LogFile.h"
+#include "LogSession.h"
+
+#if !LOG_RAW
+
+/****************
+ * internal types
+ *****************/
+typedef enum {
+    IDLE,
+    OPENING_INDEX,   //SESSIONS.TXT, for the number of the next session
+    MAKING_FOLDER,
+    OPENING_TIME_INDEX,
+    SWITCHING_FILE,  //the log goes on in the next session
+    WRITING_LINE,    //of SESSIONS.TXT
+    CLOSING_INDEX,
+    CLOSING_TIME_INDEX //of the previous session
+} sessionStep_t;
+
+/***************************************************
+* DATA
+***************************************************/
+static const char* sessionFolder;
+static const char* sessionExtension;
+static void (*sessionHeader)(void);
+
+static char sessionPath[LOG_SESSION_PATH_MAX + 1];
+static boolean opened = false;
+static boolean dated;       // named from the GPS date
+static uint8_t sessionDay;  // UTC, of a dated session
+static unsigned long sessionStartMs;
+static boolean failed;      // the last session could not be opened...
+static unsigned long failedMs; // ...then
+#if LOG_TIME_INDEX_S
+static File timeIndex;         // of a dated session
+static boolean indexed;        // a line written in this session
+static boolean justIndexed;    // by the last check
+static uint32_t indexedPeriod; // of the last line
+#endif
+
+//the session being opened, one step per log_session_service()
+static sessionStep_t step = IDLE;
+static char nextReason;
+static boolean nextDated;
+static uint8_t nextYear, nextMonth, nextDay, nextHour, nextMinute, nextSeconds;
+static uint16_t nextNumber;
+static char nextPath[LOG_SESSION_PATH_MAX + 1];
+static File sessionIndex;
+#if LOG_TIME_INDEX_S
+static File nextTimeIndex;     // until the log goes on in the next session...
+static File previousTimeIndex; // ...then the one to close
+#endif
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+static char* put_number(char* out, uint32_t value, uint8_t width) {
+    for (uint8_t i = width; i > 0; i--) {
+        out[i - 1] = '0' + value % 10;
+        value /= 10;
+    }
+    return out + width;
+}
+
+static char* put_text(char* out, const char* text) {
+    while (*text) {
+        *out++ = *text++;
+    }
+    return out;
+}
+
+/*
+ * Number of the next session : the lines of the index, opened in
+ * sessionIndex.
+ */
+static boolean open_index(void) {
+    char path[LOG_SESSION_PATH_MAX + 1];
+
+    if (strlen(sessionFolder) + 1 + strlen(LOG_SESSION_INDEX) > LOG_SESSION_PATH_MAX) {
+        return false;
+    }
+    *put_text(put_text(put_text(path, sessionFolder), "/"), LOG_SESSION_INDEX) = '\0';
+    sessionIndex = SD.open(path, FILE_WRITE);
+    if (!sessionIndex) {
+        return false;
+    }
+    nextNumber = sessionIndex.size() / LOG_SESSION_LINE;
+    return true;
+}
+
+/*
+ * Folder of the next session in nextPath, returns its end. A session with
+ * a date (year from 2000) is named from it.
+ */
+static char* put_next_folder(void) {
+    char* p = put_text(put_text(nextPath, sessionFolder), "/");
+
+    if (nextDated) {
+        p = put_number(p, 2000 + nextYear, 4);
+        p = put_number(p, nextMonth, 2);
+        p = put_number(p, nextDay, 2);
+    } else {
+        *p++ = 'S';
+        p = put_number(p, nextNumber - nextNumber % LOG_SESSION_GROUP, 5);
+    }
+    *p = '\0';
+    return p;
+}
+
+// File of the next session, after its folder ending at p.
+static void put_next_file(char* p) {
+    *p++ = '/';
+    if (nextDated) {
+        p = put_number(p, nextHour, 2);
+        p = put_number(p, nextMinute, 2);
+        p = put_number(p, nextSeconds, 2);
+    } else {
+        *p++ = 'S';
+        p = put_number(p, nextNumber, 5);
+    }
+    *put_text(put_text(p, "."), sessionExtension) = '\0';
+}
+
+#if LOG_TIME_INDEX_S
+/*
+ * Path of the time index of the session in nextPath.
+ */
+static boolean put_time_index(char* path) {
+    size_t length = strrchr(nextPath, '.') + 1 - nextPath;
+
+    if (length + strlen(LOG_TIME_INDEX_EXTENSION) > LOG_SESSION_PATH_MAX) {
+        return false;
+    }
+    memcpy(path, nextPath, length);
+    strcpy(&path[length], LOG_TIME_INDEX_EXTENSION);
+    return true;
+}
+
+/*
+ * A line for the GPS record about to be written, if it is the first one
+ * of its period.
+ */
+static void index_time(uint8_t hour, uint8_t minute, uint8_t seconds) {
+    uint32_t period = ((uint32_t)hour * 3600 + (uint16_t)minute * 60 + seconds) / LOG_TIME_INDEX_S;
+    char line[LOG_TIME_INDEX_LINE];
+    char* p;
+
+    if (!timeIndex || (indexed && period == indexedPeriod)) {
+        return;
+    }
+    p = put_number(line, hour, 2);
+    p = put_number(p, minute, 2);
+    p = put_number(p, seconds, 2);
+    *p++ = '|';
+    p = put_number(p, logFile.size(), 10);
+    put_text(p, "|\r\n");
+    timeIndex.write((const uint8_t*)line, LOG_TIME_INDEX_LINE);
+    timeIndex.flush();
+    justIndexed = true;
+    indexed = true;
+    indexedPeriod = period;
+}
+#endif
+
+/*
+ * The log goes on in nextPath. If it can't be opened, the current file
+ * goes on.
+ */
+static boolean switch_file(void) {
+    if (opened ? !logFile.rotate(nextPath) : !logFile.begin(nextPath)) {
+        return false;
+    }
+    opened = true;
+    strcpy(sessionPath, nextPath);
+    dated = nextDated;
+    sessionDay = nextDay;
+    sessionStartMs = millis();
+#if LOG_TIME_INDEX_S
+    previousTimeIndex = timeIndex;
+    timeIndex = nextTimeIndex;
+    nextTimeIndex = File();
+    indexed = false;
+#endif
+    sessionHeader();
+    return true;
+}
+
+static void write_line(void) {
+    char line[LOG_SESSION_LINE];
+    char* p;
+
+    p = put_number(line, nextNumber, 5);
+    *p++ = '|';
+    *p++ = nextReason;
+    *p++ = '|';
+    p = put_number(p, nextDated ? 20000000UL + nextYear * 10000UL + nextMonth * 100 + nextDay : 0, 8);
+    *p++ = '|';
+    p = put_number(p, nextDated ? nextHour * 10000UL + nextMinute * 100 + nextSeconds : 0, 6);
+    *p++ = '|';
+    p = put_text(p, sessionPath);
+    while (p < &line[LOG_SESSION_LINE - 3]) {
+        *p++ = ' ';
+    }
+    put_text(p, "|\r\n");
+    sessionIndex.write((const uint8_t*)line, LOG_SESSION_LINE);
+}
+
+/*
+ * A failed step : the current session goes on, the next one is tried
+ * again LOG_SESSION_RETRY_MS later.
+ */
+static void fail(void) {
+    if (sessionIndex) {
+        sessionIndex.close();
+    }
+#if LOG_TIME_INDEX_S
+    if (nextTimeIndex) {
+        char path[LOG_SESSION_PATH_MAX + 1];
+
+        nextTimeIndex.close();
+        put_time_index(path);
+        SD.remove(path); //empty
+    }
+#endif
+    failed = true;
+    failedMs = millis();
+    step = IDLE;
+}
+
+boolean log_session_service(void) {
+#if LOG_TIME_INDEX_S
+    char path[LOG_SESSION_PATH_MAX + 1];
+#endif
+    char* p;
+
+    switch (step) {
+    case IDLE:
+        return false;
+    case OPENING_INDEX:
+        if (strlen(sessionFolder) + strlen(sessionExtension) + 18 > LOG_SESSION_PATH_MAX
+                || !open_index()) {
+            fail();
+            break;
+        }
+        step = MAKING_FOLDER;
+        break;
+    case MAKING_FOLDER:
+        p = put_next_folder();
+        SD.mkdir(nextPath);
+        put_next_file(p);
+#if LOG_TIME_INDEX_S
+        step = nextDated ? OPENING_TIME_INDEX : SWITCHING_FILE;
+#else
+        step = SWITCHING_FILE;
+#endif
+        break;
+    case OPENING_TIME_INDEX:
+#if LOG_TIME_INDEX_S
+        if (put_time_index(path)) {
+            nextTimeIndex = SD.open(path, FILE_WRITE);
+        }
+#endif
+        step = SWITCHING_FILE;
+        break;
+    case SWITCHING_FILE:
+        if (!switch_file()) {
+            fail();
+            break;
+        }
+        failed = false;
+        step = WRITING_LINE;
+        break;
+    case WRITING_LINE:
+        write_line();
+        step = CLOSING_INDEX;
+        break;
+    case CLOSING_INDEX:
+        sessionIndex.close();
+        step = CLOSING_TIME_INDEX;
+        break;
+    case CLOSING_TIME_INDEX:
+#if LOG_TIME_INDEX_S
+        if (previousTimeIndex) {
+            previousTimeIndex.close();
+        }
+#endif
+        step = IDLE;
+        break;
+    }
+    return true;
+}
+
+boolean log_session_begin(const char* folder, const char* extension, void (*writeHeader)(void)) {
+    sessionFolder = folder;
+    sessionExtension = extension;
+    sessionHeader = writeHeader;
+    opened = false;
+    failed = false;
+    nextReason = LOG_SESSION_BOOT;
+    nextDated = false;
+    step = OPENING_INDEX;
+    while (log_session_service()) ;
+    return !failed;
+}
+
+boolean log_session_check(uint8_t fix, uint8_t year, uint8_t month, uint8_t day,
+                          uint8_t hour, uint8_t minute, uint8_t seconds) {
+    boolean withDate = fix && month != 0;
+    char reason;
+
+#if LOG_TIME_INDEX_S
+    justIndexed = false;
+#endif
+    if (step != IDLE) {
+        //a step here too : the log task may get no idle pass
+        log_session_service();
+        //the records before the switch end the current session, unindexed
+#if LOG_TIME_INDEX_S
+        if (step > SWITCHING_FILE && withDate) {
+            index_time(hour, minute, seconds);
+        }
+#endif
+        return true;
+    }
+    if (withDate && !dated) {
+        reason = LOG_SESSION_FIX;
+    } else if (withDate && day != sessionDay) {
+        reason = LOG_SESSION_DATE;
+    } else if (LOG_SESSION_MAX_BYTES > 0 && logFile.size() >= LOG_SESSION_MAX_BYTES) {
+        reason = LOG_SESSION_SIZE;
+    } else if (LOG_SESSION_MAX_MS > 0 && millis() - sessionStartMs >= LOG_SESSION_MAX_MS) {
+        reason = LOG_SESSION_TIME;
+    } else {
+        reason = 0;
+    }
+    if (reason != 0) {
+        if (failed && millis() - failedMs < LOG_SESSION_RETRY_MS) {
+            return false; //not tried again at each record
+        }
+        nextReason = reason;
+        nextDated = withDate;
+        nextYear = year;
+        nextMonth = month;
+        nextDay = day;
+        nextHour = hour;
+        nextMinute = minute;
+        nextSeconds = seconds;
+        step = OPENING_INDEX;
+        return true;
+    }
+#if LOG_TIME_INDEX_S
+    if (withDate) {
+        index_time(hour, minute, seconds);
+    }
+#endif
+    return true;
+}
+
+boolean log_session_indexed(void) {
+#if LOG_TIME_INDEX_S
+    return justIndexed;
+#else
+    return false;
+#endif
+}
+
+const char* log_session_path(void) {
+    return sessionPath;
+}
+
+#endif
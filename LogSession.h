@@ -0,0 +1,125 @@
+/*
+ * LogSession.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  Log sessions : a new log file per boot, per flight day and per chunk
+ *  of LOG_SESSION_MAX_BYTES or LOG_SESSION_MAX_MS, instead of a single file
+ *  growing forever (whose every open walks its whole cluster chain).
+ *
+ *  A session is opened :
+ *   - at boot, named from its number : FOLDER/S00000/S00042.CSV (a
+ *     folder per LOG_SESSION_GROUP numbers, so that the boots do not
+ *     grow a folder the next file is created in),
+ *   - at the first fix with a date, named from the GPS date and time :
+ *     FOLDER/20261016/104705.CSV (a folder per UTC day),
+ *   - when the UTC date changes, the session is too big, or too old.
+ *  Each one starts with the file header, written by the sketch.
+ *
+ *  Past the boot, a session is opened by log_session_service(), one card
+ *  operation per call, on the loop passes the log task has nothing else to
+ *  do, and by the next log_session_check() calls : a GPS record waits for
+ *  one of the folder, index and file operations at most.
+ *  The session is named from the record that made it due ; that record
+ *  and the few next ones, until the new file is open, end the previous
+ *  session.
+ *
+ *  FOLDER/SESSIONS.TXT indexes them, one fixed width line per session :
+ *      00042|F|20261016|104705|LOGS_GPS/20261016/104705.CSV    |
+ *  number, reason (LOG_SESSION_BOOT...), UTC date and time (zeros before
+ *  the fix), path. The number of the next session is the size of the
+ *  index over the line size : opening a session reads no history, and
+ *  the new file is empty, whatever the card holds.
+ *
+ *  A dated session also gets a time index, FOLDER/20261016/104207.IDX :
+ *  a line per LOG_TIME_INDEX_S of GPS time, with the UTC time of a GPS
+ *  record and its offset in the session file (the first record of the
+ *  session, then the first one of each period) :
+ *      104300|0000012486|
+ *  A session holds a single UTC date, so the time of day is enough. The
+ *  lines are fixed width and in time order : a reader finds the offset of
+ *  any time by a binary search of the index, and reads the session file
+ *  from there (host/logwindow.cpp). Each line is flushed to the card when
+ *  written ; after a power cut, the last offsets may be past the end of
+ *  the data.
+ *
+ *  Not for LOG_RAW builds : their file is already a bounded session,
+ *  reopened in O(log n) (see LogFile.h).
+ *
+ */
+
+#ifndef LOGSESSION_H_
+#define LOGSESSION_H_
+
+#include "Arduino.h"
+
+// 0 : no limit
+#ifndef LOG_SESSION_MAX_BYTES
+#define LOG_SESSION_MAX_BYTES 4194304UL // 4 MB, an hour of baro records
+#endif
+#ifndef LOG_SESSION_MAX_MS
+#define LOG_SESSION_MAX_MS 0UL
+#endif
+
+// after a session that could not be opened, the next try
+#ifndef LOG_SESSION_RETRY_MS
+#define LOG_SESSION_RETRY_MS 10000UL
+#endif
+
+// 0 : no time index
+#ifndef LOG_TIME_INDEX_S
+#define LOG_TIME_INDEX_S 60
+#endif
+
+// boot (undated) sessions per folder
+#ifndef LOG_SESSION_GROUP
+#define LOG_SESSION_GROUP 100
+#endif
+
+#define LOG_SESSION_INDEX "SESSIONS.TXT"
+#define LOG_SESSION_PATH_MAX 32 // path characters, padded in the index lines
+#define LOG_SESSION_LINE (24 + LOG_SESSION_PATH_MAX + 3) // bytes per index line, CR LF included
+#define LOG_TIME_INDEX_EXTENSION "IDX"
+#define LOG_TIME_INDEX_LINE 20 // bytes per time index line, CR LF included
+
+// reasons
+#define LOG_SESSION_BOOT 'B'
+#define LOG_SESSION_FIX 'F'
+#define LOG_SESSION_DATE 'D'
+#define LOG_SESSION_SIZE 'S'
+#define LOG_SESSION_TIME 'T'
+
+/*
+ * Boot : opens the first session in folder, with files ending in
+ * extension ("CSV"). writeHeader() starts each file. False if the card
+ * fails.
+ */
+boolean log_session_begin(const char* folder, const char* extension, void (*writeHeader)(void));
+
+/*
+ * Before each GPS record : starts opening a new session if this one is
+ * due, and indexes the record if it starts a period (see above). fix, and
+ * the UTC date (year from 2000) and time of the record. False while the
+ * last session could not be opened : the log goes on in the current file,
+ * and the session is tried again LOG_SESSION_RETRY_MS later.
+ */
+boolean log_session_check(uint8_t fix, uint8_t year, uint8_t month, uint8_t day,
+                          uint8_t hour, uint8_t minute, uint8_t seconds);
+
+/*
+ * One step of the session being opened, at most one card operation. False
+ * if there was nothing to do.
+ */
+boolean log_session_service(void);
+
+/*
+ * True if the last log_session_check() indexed its record : a reader may
+ * start there (a keyframe for LOG_DELTA, see LogDelta.h).
+ */
+boolean log_session_indexed(void);
+
+// Path of the current session file.
+const char* log_session_path(void);
+
+#endif /* LOGSESSION_H_ */
@@ -0,0 +1,19 @@
+/*
+ * PowersOf10.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See PowersOf10.h.
+ *
+ */
+
+#include "PowersOf10.h"
+
+/***************************************************
+* DATA
+***************************************************/
+const uint32_t powersOf10[POWERS_OF_10] PROGMEM = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL,
+    1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
@@ -0,0 +1,30 @@
+/*
+ * PowersOf10.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  The 32 bits powers of ten, 10^0 to 10^9, in flash : one table for the
+ *  NMEA field conversions (GPSMTK339.cpp) and the CSV digits
+ *  (LogFormat.cpp), out of the RAM.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef POWERSOF10_H_
+#define POWERSOF10_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#define POWERS_OF_10 10
+
+extern const uint32_t powersOf10[POWERS_OF_10] PROGMEM;
+
+// 10^n, n < POWERS_OF_10
+static inline uint32_t power_of_10(uint8_t n) {
+    return pgm_read_dword(&powersOf10[n]);
+}
+
+#endif /* POWERSOF10_H_ */
@@ -0,0 +1,176 @@
+/*
+ * Pps.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See Pps.h.
+ *
+ */
+
+#include "Pps.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#endif
+
+#define PPS_NOMINAL_US 1000000UL
+#define SECONDS_PER_DAY 86400UL
+
+/***************************************************
+* DATA
+***************************************************/
+// written by the interrupt
+static volatile unsigned long edgeMicros;
+static volatile unsigned long periodUs = PPS_NOMINAL_US; // board clock second
+static volatile boolean edgeSeen = false;
+
+// an edge and the UTC second it starts, moved to the last edge by pps_utc()
+static unsigned long anchorMicros;
+static uint32_t anchorSecond;
+static boolean anchored = false;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+boolean pps_begin(uint8_t pin) {
+    edgeSeen = false;
+    periodUs = PPS_NOMINAL_US;
+    anchored = false;
+    return pps_hw_attach(pin);
+}
+
+void pps_edge(void) {
+    unsigned long now = micros();
+    unsigned long interval = now - edgeMicros;
+
+    if (edgeSeen) {
+        if (interval < PPS_NOMINAL_US - PPS_TOLERANCE_US) {
+            return; //glitch
+        }
+        if (interval < PPS_NOMINAL_US + PPS_TOLERANCE_US) {
+            periodUs = interval;
+        }
+        //else pulses were missed : the period is kept
+    }
+    edgeMicros = now;
+    edgeSeen = true;
+}
+
+/*
+ * Last edge and board clock second, consistent with each other.
+ */
+static boolean lastEdge(unsigned long* edge, unsigned long* period) {
+    boolean seen;
+
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+    {
+        *edge = edgeMicros;
+        *period = periodUs;
+        seen = edgeSeen;
+    }
+    return seen;
+}
+
+void pps_fix(uint8_t hour, uint8_t minute, uint8_t seconds, uint16_t milliseconds,
+             unsigned long fixMicros) {
+    unsigned long edge, period;
+
+    //the time of a sentence is the one of the edge before it
+    if (milliseconds != 0 || !lastEdge(&edge, &period) || fixMicros - edge >= period) {
+        return;
+    }
+    anchorMicros = edge;
+    anchorSecond = (uint32_t)hour * 3600 + (uint16_t)minute * 60 + seconds;
+    anchored = true;
+}
+
+boolean pps_utc(unsigned long stamp, uint32_t* utcDms) {
+    unsigned long edge, period;
+    int32_t elapsed;
+    int32_t fraction;
+    uint16_t period16;
+    uint32_t utc;
+
+    if (!anchored || !lastEdge(&edge, &period)) {
+        return false;
+    }
+    //seconds from the anchor to the last edge, one turn per edge since the last call
+    while ((long)(edge - anchorMicros) > (long)(period / 2)) {
+        anchorMicros += period;
+        anchorSecond++;
+        if (anchorSecond == SECONDS_PER_DAY) {
+            anchorSecond = 0;
+        }
+    }
+    anchorMicros = edge;
+
+    elapsed = (int32_t)(stamp - edge);
+    if (elapsed > PPS_HOLDOVER_US || elapsed < -PPS_HOLDOVER_US) {
+        return false;
+    }
+    //1/10 ms = elapsed * 10000 / period, in 32 bits
+    period16 = period >> 4;
+    if (elapsed < 0) {
+        fraction = -(int32_t)(((uint32_t)-elapsed * 625 + period16 / 2) / period16);
+    } else {
+        fraction = ((uint32_t)elapsed * 625 + period16 / 2) / period16;
+    }
+
+    utc = anchorSecond * 10000 + fraction;
+    if (fraction < 0 && anchorSecond * 10000 < (uint32_t)-fraction) {
+        utc += PPS_DAY_DMS;
+    } else if (utc >= PPS_DAY_DMS) {
+        utc -= PPS_DAY_DMS;
+    }
+    *utcDms = utc;
+    return true;
+}
+
+/**************************
+ * ATmega328 external interrupts : INT0 on pin 2, INT1 on pin 3, rising
+ * edge. Only the vector of PPS_PIN is defined.
+ **************************/
+#if defined(__AVR__)
+#if PPS_PIN == 2 || PPS_PIN == 3
+
+boolean pps_hw_attach(uint8_t pin) {
+    if (pin != PPS_PIN) {
+        return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#if PPS_PIN == 2
+        EICRA |= _BV(ISC01) | _BV(ISC00);
+        EIFR = _BV(INTF0);
+        EIMSK |= _BV(INT0);
+#else
+        EICRA |= _BV(ISC11) | _BV(ISC10);
+        EIFR = _BV(INTF1);
+        EIMSK |= _BV(INT1);
+#endif
+    }
+    return true;
+}
+
+#if PPS_PIN == 2
+ISR(INT0_vect) {
+#else
+ISR(INT1_vect) {
+#endif
+    pps_edge();
+}
+
+#else
+
+boolean pps_hw_attach(uint8_t pin) {
+    (void)pin;
+    return false;
+}
+
+#endif
+#endif
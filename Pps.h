@@ -0,0 +1,78 @@
+/*
+ * Pps.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  GPS PPS (pulse per second) input : maps micros() to UTC.
+ *
+ *  The rising edge of PPS is the start of a UTC second, to a few tens of
+ *  ns. Its micros() is taken by interrupt, and the board clock second is
+ *  measured between two edges. A fix on a whole second names the edge
+ *  before it (pps_fix()) : from then on, any micros() within a couple of
+ *  seconds of the last edge is turned into UTC by pps_utc(), to the
+ *  micros() resolution (4 us on a 16 MHz AVR) plus the interrupt latency,
+ *  whatever the NMEA sentence latency.
+ *  The mapping follows the edges by itself : a fix is only needed once,
+ *  and again after more than PPS_HOLDOVER_US without any edge.
+ *
+ */
+
+#ifndef PPS_H_
+#define PPS_H_
+
+#include "Arduino.h"
+
+// Edges further than that from a second of the board clock are glitches
+#ifndef PPS_TOLERANCE_US
+#define PPS_TOLERANCE_US 10000
+#endif
+
+// pps_utc() only answers within that time of the last edge
+#ifndef PPS_HOLDOVER_US
+#define PPS_HOLDOVER_US 2000000L
+#endif
+
+/*
+ * Pin of the PPS input on the AVR : 2 (INT0) or 3 (INT1), whose vector the
+ * driver then owns, that one only. 0 : no PPS, and no vector, as a sketch
+ * using attachInterrupt() needs (its core file claims them all).
+ */
+#ifndef PPS_PIN
+#define PPS_PIN 0
+#endif
+
+// UTC in 1/10 ms since midnight : 0 to 863999999
+#define PPS_DAY_DMS 864000000UL
+
+/*
+ * Starts listening to PPS on pin (rising edges). False if the pin has no
+ * supported interrupt, or is not PPS_PIN on the AVR : pps_utc() then never
+ * answers.
+ */
+boolean pps_begin(uint8_t pin);
+
+/*
+ * A fix of UTC hour:minute:seconds.milliseconds, received (or written) at
+ * fixMicros. On a whole second, names the last edge if it is less than a
+ * second old.
+ */
+void pps_fix(uint8_t hour, uint8_t minute, uint8_t seconds, uint16_t milliseconds,
+             unsigned long fixMicros);
+
+/*
+ * UTC of a micros() value, in 1/10 ms since midnight, to *utcDms. False if
+ * the mapping is not known yet, or if the last edge is too far from it.
+ */
+boolean pps_utc(unsigned long stamp, uint32_t* utcDms);
+
+/*
+ * Hardware layer, implemented at the end of Pps.cpp for the AVR. Host
+ * builds provide their own (see host/hal/mock_hal.cpp).
+ */
+boolean pps_hw_attach(uint8_t pin);
+
+// Interrupt body : called on each rising edge of PPS.
+void pps_edge(void);
+
+#endif /* PPS_H_ */
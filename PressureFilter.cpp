@@ -0,0 +1,170 @@
+/*
+ * PressureFilter.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See PressureFilter.h.
+ *
+ */
+
+#include "PressureFilter.h"
+
+#define IIR_SHIFT_MAX 15
+
+/***************************************************
+* DATA
+***************************************************/
+static uint8_t filterMode = PRESSURE_FILTER_INTERVAL;
+static uint8_t filterParam = 1;
+static int32_t lastFiltered = 0;
+
+// last samples (AVERAGE, MEDIAN)
+static int32_t window[PRESSURE_FILTER_WINDOW];
+static uint8_t windowNext = 0;
+static uint8_t windowCount = 0;
+static int32_t windowSum = 0;
+
+// IIR, Q8
+static int32_t iirState = 0;
+static uint8_t iirStarted = 0;
+
+// samples since the last record : sums relative to the first one, so a
+// long interval can't overflow
+static int32_t intervalBase = 0;
+static int32_t intervalDeltaSum = 0;
+static uint16_t intervalCount = 0;
+static int32_t intervalMin = 0;
+static int32_t intervalMax = 0;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+void pressure_filter_begin(uint8_t mode, uint8_t param) {
+    filterMode = mode;
+    if (mode == PRESSURE_FILTER_IIR) {
+        filterParam = param > IIR_SHIFT_MAX ? IIR_SHIFT_MAX : param;
+    } else if (param == 0) {
+        filterParam = 1;
+    } else {
+        filterParam = param > PRESSURE_FILTER_WINDOW ? PRESSURE_FILTER_WINDOW : param;
+    }
+    lastFiltered = 0;
+    windowNext = 0;
+    windowCount = 0;
+    windowSum = 0;
+    iirStarted = 0;
+    intervalCount = 0;
+}
+
+void pressure_filter_add(int32_t pressure) {
+    if (intervalCount == 0) {
+        intervalBase = pressure;
+        intervalDeltaSum = 0;
+        intervalMin = pressure;
+        intervalMax = pressure;
+    } else if (pressure < intervalMin) {
+        intervalMin = pressure;
+    } else if (pressure > intervalMax) {
+        intervalMax = pressure;
+    }
+    if (intervalCount < 0xFFFF) {
+        intervalDeltaSum += pressure - intervalBase;
+        intervalCount++;
+    }
+
+    switch (filterMode) {
+        case PRESSURE_FILTER_AVERAGE :
+        case PRESSURE_FILTER_MEDIAN :
+            if (windowCount == filterParam) {
+                windowSum -= window[windowNext];
+            } else {
+                windowCount++;
+            }
+            window[windowNext] = pressure;
+            windowSum += pressure;
+            windowNext++;
+            if (windowNext == filterParam) {
+                windowNext = 0;
+            }
+            break;
+        case PRESSURE_FILTER_IIR :
+            if (!iirStarted) {
+                iirState = pressure << 8;
+                iirStarted = 1;
+            } else {
+                iirState += ((pressure << 8) - iirState) >> filterParam;
+            }
+            break;
+        default :
+            break;
+    }
+}
+
+/*
+ * Median of the window : sorted copy, insertion sort (a few samples, once
+ * per record).
+ */
+static int32_t windowMedian(void) {
+    int32_t sorted[PRESSURE_FILTER_WINDOW];
+    uint8_t i, j;
+
+    for (i = 0; i < windowCount; i++) {
+        int32_t value = window[i];
+        for (j = i; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    if (windowCount & 1) {
+        return sorted[windowCount / 2];
+    }
+    return (sorted[windowCount / 2 - 1] + sorted[windowCount / 2] + 1) / 2;
+}
+
+// value / count, rounded half away from zero
+static int32_t roundedQuotient(int32_t value, uint16_t count) {
+    if (value < 0) {
+        return -((-value + count / 2) / count);
+    }
+    return (value + count / 2) / count;
+}
+
+void pressure_filter_take(pressureInterval_t* out) {
+    int32_t filtered = lastFiltered;
+
+    switch (filterMode) {
+        case PRESSURE_FILTER_INTERVAL :
+            if (intervalCount > 0) {
+                filtered = intervalBase + roundedQuotient(intervalDeltaSum, intervalCount);
+            }
+            break;
+        case PRESSURE_FILTER_AVERAGE :
+            if (windowCount > 0) {
+                filtered = roundedQuotient(windowSum, windowCount);
+            }
+            break;
+        case PRESSURE_FILTER_IIR :
+            if (iirStarted) {
+                filtered = (iirState + 128) >> 8;
+            }
+            break;
+        case PRESSURE_FILTER_MEDIAN :
+            if (windowCount > 0) {
+                filtered = windowMedian();
+            }
+            break;
+        default :
+            break;
+    }
+
+    out->filtered = filtered;
+    out->count = intervalCount;
+    out->min = intervalCount > 0 ? intervalMin : 0;
+    out->max = intervalCount > 0 ? intervalMax : 0;
+
+    lastFiltered = filtered;
+    intervalCount = 0;
+}
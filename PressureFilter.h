@@ -0,0 +1,61 @@
+/*
+ * PressureFilter.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Filter stage between the BMP085 cycle and the log : every pressure
+ *  sample goes in (tens per second), the log takes one value per record.
+ *  Integer only. Modes :
+ *   - PRESSURE_FILTER_INTERVAL : mean of the samples since the last record,
+ *   - PRESSURE_FILTER_AVERAGE  : moving average of the last `param` samples,
+ *   - PRESSURE_FILTER_IIR      : exponential, y += (x - y) / 2^param (Q8),
+ *   - PRESSURE_FILTER_MEDIAN   : median of the last `param` samples.
+ *  Whatever the mode, the count and min/max of the samples since the last
+ *  record come with the value.
+ *
+ *  Shared with the host tools : plain C types only.
+ *
+ */
+
+#ifndef PRESSUREFILTER_H_
+#define PRESSUREFILTER_H_
+
+#include <stdint.h>
+
+#define PRESSURE_FILTER_INTERVAL 0
+#define PRESSURE_FILTER_AVERAGE  1
+#define PRESSURE_FILTER_IIR      2
+#define PRESSURE_FILTER_MEDIAN   3
+
+/*
+ * Samples kept for the moving average and the median (4 bytes each).
+ */
+#ifndef PRESSURE_FILTER_WINDOW
+#define PRESSURE_FILTER_WINDOW 16
+#endif
+
+typedef struct {
+    int32_t filtered;  // Pa
+    uint16_t count;    // samples since the last record
+    int32_t min;       // Pa, 0 if no sample
+    int32_t max;
+} pressureInterval_t;
+
+/*
+ * Selects the mode, with its window (samples, at most
+ * PRESSURE_FILTER_WINDOW) or its IIR shift, and forgets the samples.
+ */
+void pressure_filter_begin(uint8_t mode, uint8_t param);
+
+// A new sample, in Pa.
+void pressure_filter_add(int32_t pressure);
+
+/*
+ * The filtered value and the interval statistics, then starts a new
+ * interval. Without any sample since the last call, the value stays the
+ * previous one (INTERVAL) or the one of the window.
+ */
+void pressure_filter_take(pressureInterval_t* out);
+
+#endif /* PRESSUREFILTER_H_ */
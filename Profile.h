@@ -0,0 +1,42 @@
+/*
+ * Profile.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Timing hooks around the steps of the main loop.
+ *  They compile to nothing unless PROFILE_ENABLED is defined, in which case
+ *  the benchmark harness (see host/) provides profile_begin() and profile_end().
+ *
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+typedef enum {
+    PROFILE_GPS_PARSE,   // gps_read_serial_and_parse_nmea
+    PROFILE_BMP_CYCLE,   // updateBMP085Cycle
+    PROFILE_BMP_READ,    // readBMP085All
+    PROFILE_FUSION,      // alt_fusion_baro
+    PROFILE_WRITE_LOG,   // writeGpsData
+    PROFILE_WRITE_BARO,  // writeBaroData
+    PROFILE_LOG_SERVICE, // logFile.service
+    PROFILE_COUNT
+} profileId_t;
+
+#ifdef PROFILE_ENABLED
+
+void profile_begin(profileId_t id);
+void profile_end(profileId_t id);
+
+#define PROFILE_BEGIN(id) profile_begin(id)
+#define PROFILE_END(id)   profile_end(id)
+
+#else
+
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+
+#endif
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,86 @@
+/*
+ * Scheduler.cpp
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  See Scheduler.h.
+ *
+ */
+
+#include "Scheduler.h"
+
+/***************************************************
+* DATA
+***************************************************/
+static schedTask_t* first = NULL;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+void sched_add(schedTask_t* task) {
+    schedTask_t** link = &first;
+
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    task->next = NULL;
+    task->released = task->periodUs != SCHED_ON_RELEASE;
+    task->releaseMicros = micros();
+    *link = task;
+}
+
+void sched_release(schedTask_t* task) {
+    if (!task->released) {
+        task->released = true;
+        task->releaseMicros = micros();
+    }
+}
+
+/*
+ * Lateness of a start, against the deadline, then the next release.
+ */
+static void account(schedTask_t* task, unsigned long now) {
+    uint32_t late = now - task->releaseMicros;
+
+    task->runs++;
+    if (late > task->deadlineUs) {
+        task->misses++;
+    }
+    if (late > task->worstLateUs) {
+        task->worstLateUs = late;
+    }
+
+    if (task->periodUs == SCHED_ON_RELEASE) {
+        task->released = false;
+    } else if (task->periodUs == SCHED_EVERY_PASS) {
+        task->releaseMicros = now;
+    } else {
+        //the first release after now : the missed ones are dropped
+        do {
+            task->releaseMicros += task->periodUs;
+        } while ((long)(now - task->releaseMicros) >= 0);
+    }
+}
+
+void sched_run(void) {
+    schedTask_t* task;
+    boolean busy = false;
+
+    for (task = first; task != NULL; task = task->next) {
+        unsigned long now = micros();
+
+        if (!task->released || (long)(now - task->releaseMicros) < 0) {
+            continue;
+        }
+        if ((task->flags & SCHED_BACKGROUND) && busy) {
+            continue;
+        }
+        account(task, now);
+        if (task->run()) {
+            busy = true;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Scheduler.h
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: neuf
+ *
+ *  Cooperative scheduler for loop() : each call of sched_run() is one
+ *  pass over the tasks, in priority order (the order of sched_add()). A
+ *  task runs on a pass when it is released :
+ *   - SCHED_EVERY_PASS tasks always are,
+ *   - periodic tasks each periodUs (a late run does not pile up runs),
+ *   - SCHED_ON_RELEASE tasks once per sched_release(), e.g. by another
+ *     task on the same pass.
+ *  A task returns true when it had work. SCHED_BACKGROUND tasks only run
+ *  on passes where no task before them had work : they take the idle
+ *  passes, and must keep each run short (a slice of their work), as
+ *  nothing preempts them.
+ *
+ *  Each task has a deadline : the longest time from its release to its
+ *  start (for SCHED_EVERY_PASS, from one start to the next). Starts later
+ *  than that are counted in misses, the worst one in worstLateUs.
+ *
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "Arduino.h"
+
+#define SCHED_EVERY_PASS 0UL
+#define SCHED_ON_RELEASE 0xFFFFFFFFUL
+
+// flags
+#define SCHED_BACKGROUND 0x01
+
+typedef struct schedTask {
+    boolean (*run)(void);  // true if it had work
+    uint32_t periodUs;     // SCHED_EVERY_PASS, SCHED_ON_RELEASE or a period
+    uint32_t deadlineUs;
+    uint8_t flags;
+    //kept by the scheduler, start at 0
+    struct schedTask* next;
+    boolean released;
+    unsigned long releaseMicros;
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t worstLateUs;
+} schedTask_t;
+
+/*
+ * Adds task after the ones already added, i.e. with a lower priority.
+ * Periodic tasks are released at once.
+ */
+void sched_add(schedTask_t* task);
+
+// Releases a SCHED_ON_RELEASE task : it runs on the next pass reaching it.
+void sched_release(schedTask_t* task);
+
+// One pass over the tasks.
+void sched_run(void);
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,178 @@
+/*
+ * Twi.cpp
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  See Twi.h.
+ *
+ */
+
+#include "Twi.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+#endif
+
+#define QUEUE_MASK (TWI_QUEUE_SIZE - 1)
+
+#if (TWI_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "TWI_QUEUE_SIZE must be a power of two"
+#endif
+
+/***************************************************
+* DATA
+***************************************************/
+static twiTransaction_t* volatile queue[TWI_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;  // running transaction, if any
+static volatile uint8_t queueCount = 0;
+
+
+/***************************************************
+* FUNCTIONS
+***************************************************/
+
+void twi_begin(void) {
+    queueHead = 0;
+    queueCount = 0;
+    twi_hw_begin();
+}
+
+boolean twi_queue(twiTransaction_t* t) {
+    boolean queued = false;
+
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+    {
+        if (queueCount < TWI_QUEUE_SIZE) {
+            t->status = TWI_PENDING;
+            queue[(queueHead + queueCount) & QUEUE_MASK] = t;
+            queueCount++;
+            queued = true;
+            if (queueCount == 1) {
+                //bus idle
+                twi_hw_start(t);
+            }
+        }
+    }
+    return queued;
+}
+
+uint8_t twi_wait(twiTransaction_t* t) {
+    unsigned long start = millis();
+
+    while (t->status == TWI_PENDING) {
+        if (millis() - start >= TWI_TIMEOUT_MS) {
+            twi_reset();
+            break;
+        }
+        delayMicroseconds(10);
+    }
+    return t->status;
+}
+
+void twi_reset(void) {
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+    {
+        twi_hw_begin();
+        while (queueCount > 0) {
+            queue[queueHead]->status = TWI_ERROR;
+            queueHead = (queueHead + 1) & QUEUE_MASK;
+            queueCount--;
+        }
+    }
+}
+
+/*
+ * Interrupt context : completes the head of the queue, starts the next one.
+ */
+void twi_hw_done(uint8_t status) {
+    queue[queueHead]->status = status;
+    queueHead = (queueHead + 1) & QUEUE_MASK;
+    queueCount--;
+    if (queueCount > 0) {
+        twi_hw_start(queue[queueHead]);
+    }
+}
+
+/**************************
+ * ATmega328 TWI
+ **************************/
+#if defined(__AVR__) && !defined(TWI_EXTERNAL_HW)
+
+#define TWCR_RUN (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+static twiTransaction_t* active;
+static uint8_t byteIndex;
+static boolean reading;
+
+void twi_hw_begin(void) {
+    TWCR = 0; //stops the TWI, whatever it was doing
+    //internal pull ups on SDA (PC4) and SCL (PC5), as Wire does
+    PORTC |= _BV(PORTC4) | _BV(PORTC5);
+    TWSR = 0; //prescaler 1
+    TWBR = ((F_CPU / TWI_FREQ) - 16) / 2;
+    TWCR = _BV(TWEN);
+}
+
+void twi_hw_start(twiTransaction_t* t) {
+    active = t;
+    byteIndex = 0;
+    reading = (t->txLength == 0);
+    //a stop of the previous transaction may still be on its way
+    while (TWCR & _BV(TWSTO)) {
+        ;
+    }
+    TWCR = TWCR_RUN | _BV(TWSTA);
+}
+
+static void finish(uint8_t status) {
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+    twi_hw_done(status);
+}
+
+ISR(TWI_vect) {
+    switch (TW_STATUS) {
+        case TW_START:
+        case TW_REP_START:
+            TWDR = (active->address << 1) | (reading ? TW_READ : TW_WRITE);
+            TWCR = TWCR_RUN;
+            break;
+        case TW_MT_SLA_ACK:
+        case TW_MT_DATA_ACK:
+            if (byteIndex < active->txLength) {
+                TWDR = active->txData[byteIndex++];
+                TWCR = TWCR_RUN;
+            } else if (active->rxLength > 0) {
+                reading = true;
+                byteIndex = 0;
+                TWCR = TWCR_RUN | _BV(TWSTA);
+            } else {
+                finish(TWI_OK);
+            }
+            break;
+        case TW_MR_SLA_ACK:
+            //ACK every byte but the last one
+            TWCR = TWCR_RUN | (active->rxLength > 1 ? _BV(TWEA) : 0);
+            break;
+        case TW_MR_DATA_ACK:
+            active->rxData[byteIndex++] = TWDR;
+            TWCR = TWCR_RUN | (byteIndex + 1 < active->rxLength ? _BV(TWEA) : 0);
+            break;
+        case TW_MR_DATA_NACK:
+            active->rxData[byteIndex++] = TWDR;
+            finish(TWI_OK);
+            break;
+        default:
+            //NACK on address or data, lost arbitration, bus error
+            finish(TWI_ERROR);
+            break;
+    }
+}
+
+#endif
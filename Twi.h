@@ -0,0 +1,87 @@
+/*
+ * Twi.h
+ *
+ *  Created on: 16 oct. 2026
+ *      Author: neuf
+ *
+ *  Interrupt driven I2C master (TWI), without any busy wait.
+ *
+ *  A transaction writes txLength bytes then, after a repeated start, reads
+ *  rxLength bytes (either part may be empty). The caller owns the
+ *  transaction and its buffers, queues it, and later finds the result in
+ *  its status : the TWI interrupt runs the queued transactions one after
+ *  the other, in the background.
+ *
+ *  This driver owns the TWI and its vector : Wire must not be used.
+ *
+ */
+
+#ifndef TWI_H_
+#define TWI_H_
+
+#include "Arduino.h"
+
+#ifndef TWI_FREQ
+#define TWI_FREQ 100000UL
+#endif
+
+/*
+ * Transactions waiting or running at once. Power of two.
+ */
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE 4
+#endif
+
+// twi_wait() gives up after that : a bus that never completes (SDA held low)
+#ifndef TWI_TIMEOUT_MS
+#define TWI_TIMEOUT_MS 25
+#endif
+
+#define TWI_PENDING 0
+#define TWI_OK      1
+#define TWI_ERROR   2 // NACK, lost arbitration, bus error
+
+typedef struct {
+    uint8_t address;        // 7 bits
+    const uint8_t* txData;
+    uint8_t txLength;
+    uint8_t* rxData;
+    uint8_t rxLength;
+    volatile uint8_t status;
+} twiTransaction_t;
+
+void twi_begin(void);
+
+/*
+ * Queues t (left untouched by the caller until its status is no longer
+ * TWI_PENDING). Returns false if the queue is full : t is not queued, its
+ * status left as it was.
+ */
+boolean twi_queue(twiTransaction_t* t);
+
+/*
+ * Waits for t to complete, returns its status. Blocking : for setup code.
+ * After TWI_TIMEOUT_MS, resets the TWI (twi_reset()) : TWI_ERROR.
+ */
+uint8_t twi_wait(twiTransaction_t* t);
+
+/*
+ * Ends every queued transaction with TWI_ERROR, the running one included,
+ * and starts the TWI over.
+ */
+void twi_reset(void);
+
+/*
+ * Hardware layer, implemented at the end of Twi.cpp for the AVR (unless
+ * TWI_EXTERNAL_HW is defined). Host builds provide their own (see
+ * host/hal/mock_hal.cpp).
+ */
+// Also called to reset the TWI : whatever was running is dropped.
+void twi_hw_begin(void);
+// Runs t on the bus. Called with the bus idle.
+void twi_hw_start(twiTransaction_t* t);
+
+// Interrupt side : the running transaction is over.
+void twi_hw_done(uint8_t status);
+
+#endif /* TWI_H_ */
@@ -0,0 +1,489 @@
+/*
+ * bench_avr.cpp
+ *
+ *  Cycle benchmarks of the logger hot paths, built for the ATmega328 and run
+ *  under simavr (see Makefile). Each benchmark is run BENCH_RUNS times, timed
+ *  with Timer1 at the CPU clock, and its stack use is measured by painting
+ *  the free RAM before the call.
+ *
+ *  The output is a fixed width table, written on the simavr console : the
+ *  simulator is cycle accurate, so two runs of the same build give the same
+ *  numbers and tables of two commits can be diffed.
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <avr/avr_mcu_section.h>
+
+#include "Arduino.h"
+#include "AltitudeFusion.h"
+#include "BMP085.h"
+#include "BaroAltitude.h"
+#include "GPSMTK339.h"
+#include "GpsUart.h"
+#include "LogDelta.h"
+#include "LogFile.h"
+#include "LogFormat.h"
+#include "Pps.h"
+#include "PressureFilter.h"
+#include "Scheduler.h"
+#include "avr_hal.h"
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+#define BENCH_RUNS 16
+#define STACK_PAINT 0xA5
+
+/***************************************************
+* Code under test
+***************************************************/
+extern t_gpsData gps_data;            // GpsLogger.cpp
+extern bmpData_t bmp085Data;
+extern int16_t ac1, ac2, ac3, b1, b2, mb, mc, md; // BMP085.cpp
+extern uint16_t ac4, ac5, ac6;
+extern int16_t UT;
+extern int32_t UP;
+extern uint8_t oversampling;
+void writeGpsData(void);
+void writeBaroData(void);
+void fillGpsRecord(logGpsRecord_t* record);
+
+extern uint8_t __heap_start;
+
+/***************************************************
+* Inputs
+***************************************************/
+static const char line_rmc[] PROGMEM =
+        "$GPRMC,104207.000,A,4511.3127,N,00543.4773,E,18.00,72.00,161026,,,A*63\r\n";
+static const char line_gga[] PROGMEM =
+        "$GPGGA,104207.000,4511.3127,N,00543.4773,E,1,8,0.90,209.6,M,48.6,M,,*59\r\n";
+static const char line_vtg[] PROGMEM =
+        "$GNVTG,72.00,T,,M,18.00,N,33.34,K,A*18\r\n";
+static const char line_gsa[] PROGMEM =
+        "$GNGSA,A,3,02,05,07,09,13,15,20,29,,,,,1.53,0.90,1.26*11\r\n";
+static const char line_gsv[] PROGMEM =
+        "$GPGSV,3,1,12,01,28,62,36,02,62,171,22,03,30,250,35,04,68,93,30*71\r\n";
+static const char stream_fix[] PROGMEM =
+        "$GPGGA,104208.000,4511.3143,N,00543.4842,E,1,8,0.91,212.6,M,48.6,M,,*52\r\n"
+        "$GPRMC,104208.000,A,4511.3143,N,00543.4842,E,18.17,72.53,161026,,,A*63\r\n";
+
+/***************************************************
+* Benchmarks
+***************************************************/
+class NullPrint : public Print {
+public:
+    virtual size_t write(uint8_t c) { (void)c; return 1; }
+    using Print::write;
+};
+
+static NullPrint nullPrint;
+static t_gpsData gps;
+static bmpData_t bmp;
+static logGpsRecord_t record;
+static char line[LOG_TEXT_MAX];
+
+static void setup_nothing(void) {}
+static void run_nothing(void) {}
+
+static void parse_line_P(const char *line) {
+    char c;
+    while ((c = pgm_read_byte(line++)) != 0) {
+        gps_parse_nmea_char(c, &gps);
+    }
+}
+
+static void run_rmc(void) { parse_line_P(line_rmc); }
+static void run_gga(void) { parse_line_P(line_gga); }
+static void run_vtg(void) { parse_line_P(line_vtg); }
+static void run_gsa(void) { parse_line_P(line_gsa); }
+static void run_gsv(void) { parse_line_P(line_gsv); }
+
+static void setup_stream(void) {
+    const char *p = stream_fix;
+    char c;
+    while ((c = pgm_read_byte(p++)) != 0) {
+        gps_uart_rx_byte(c);
+    }
+}
+static void run_stream(void) { gps_read_serial_and_parse_nmea(&gps); }
+
+static void setup_rx_byte(void) {
+    while (gps_uart_read() >= 0) {
+        ;
+    }
+}
+static void run_rx_byte(void) { gps_uart_rx_byte('$'); }
+
+static void run_bmp_cycle(void) { updateBMP085Cycle(); }
+
+static void run_bmp_read(void) { readBMP085All(101325.0, &bmp); }
+static void run_bmp_compensate(void) { compensateBMP085(&bmp); }
+
+/*
+ * The compensation as it was before compensateBMP085() : float temperature
+ * steps through pow(), kept for comparison.
+ */
+static float powTemperature;
+static int32_t powPressure;
+static float powAltitude;
+static int32_t altitudeCm;
+
+static void run_bmp_compensate_pow(void) {
+    int32_t B3, B5, B6, X1, X2, X3;
+    uint32_t B4, B7;
+
+    X1 = (UT - (int32_t)ac6) * ((int32_t)ac5) / pow(2,15);
+    X2 = ((int32_t)mc * pow(2,11)) / (X1+(int32_t)md);
+    B5 = X1 + X2;
+
+    powTemperature = (B5+8)/pow(2,4);
+    powTemperature /= 10;
+
+    B6 = B5 - 4000;
+    X1 = ((int32_t)b2 * ( (B6 * B6)>>12 )) >> 11;
+    X2 = ((int32_t)ac2 * B6) >> 11;
+    X3 = X1 + X2;
+    B3 = ((((int32_t)ac1*4 + X3) << oversampling) + 2) / 4;
+
+    X1 = ((int32_t)ac3 * B6) >> 13;
+    X2 = ((int32_t)b1 * ((B6 * B6) >> 12)) >> 16;
+    X3 = ((X1 + X2) + 2) >> 2;
+    B4 = ((uint32_t)ac4 * (uint32_t)(X3 + 32768)) >> 15;
+    B7 = ((uint32_t)UP - B3) * (uint32_t)( 50000UL >> oversampling );
+
+    if (B7 < 0x80000000) {
+        powPressure = (B7 * 2) / B4;
+    } else {
+        powPressure = (B7 / B4) * 2;
+    }
+
+    X1 = (powPressure >> 8) * (powPressure >> 8);
+    X1 = (X1 * 3038) >> 16;
+    X2 = (-7357 * powPressure) >> 16;
+
+    powPressure = powPressure + ((X1 + X2 + (int32_t)3791)>>4);
+}
+
+static pressureInterval_t interval;
+
+static void run_filter_add(void) { pressure_filter_add(98800); }
+
+static void setup_filter_median(void) {
+    pressure_filter_begin(PRESSURE_FILTER_MEDIAN, 15);
+    for (uint8_t i = 0; i < 15; i++) {
+        pressure_filter_add(98800 + (i * 7) % 13);
+    }
+}
+static void run_filter_take(void) { pressure_filter_take(&interval); }
+
+// one step : a sample 15.7 ms after the first one, 40 cm higher
+static uint32_t fusionMicros;
+
+static void setup_fusion(void) {
+    alt_fusion_begin(101325);
+    fusionMicros = 0;
+    alt_fusion_baro(300000, fusionMicros);
+    alt_fusion_gps(302000, 90);
+}
+static void run_fusion_baro(void) {
+    fusionMicros += 15700;
+    alt_fusion_baro(300040, fusionMicros);
+}
+static void run_fusion_gps(void) { alt_fusion_gps(300500, 90); }
+
+// a sample half a second after the last edge, named by a fix
+static uint32_t ppsUtc;
+
+static void setup_pps(void) {
+    pps_begin(2);
+    pps_edge();
+    pps_fix(10, 42, 7, 0, micros());
+}
+static void run_pps_utc(void) { pps_utc(micros() + 500000, &ppsUtc); }
+
+// scheduler overhead : a pass over the logger's four tasks, idle
+static boolean idle_task(void) { return false; }
+static schedTask_t idleTasks[4] = {
+    { idle_task, SCHED_EVERY_PASS, 3000, 0 },
+    { idle_task, SCHED_EVERY_PASS, 100000, 0 },
+    { idle_task, SCHED_ON_RELEASE, 10000, 0 },
+    { idle_task, SCHED_EVERY_PASS, 500000, SCHED_BACKGROUND },
+};
+
+static void setup_sched(void) {
+    static boolean added = false;
+    if (!added) {
+        for (uint8_t i = 0; i < 4; i++) {
+            sched_add(&idleTasks[i]);
+        }
+        added = true;
+    }
+}
+static void run_sched(void) { sched_run(); }
+
+static void run_altitude(void) { altitudeCm = baro_altitude_cm(69964); }
+static void run_altitude_pow(void) { powAltitude = 44330 * (1.0 - pow(((float)69964) / 101325.0, 0.1903)); }
+
+static void run_print_float8(void) { nullPrint.print(45.18854522, 8); }
+static void run_print_float2(void) { nullPrint.print(98787.25, 2); }
+
+static void setup_write(void) {
+    gps_data = gps;
+    bmp085Data = bmp;
+}
+static void run_write(void) { writeGpsData(); }
+static void run_write_baro(void) { writeBaroData(); }
+static void run_fill_record(void) { fillGpsRecord(&record); }
+
+static void setup_format(void) {
+    setup_write();
+    fillGpsRecord(&record);
+}
+static void run_format(void) { log_format_gps(line, &record); }
+
+// the next record of a 10 Hz flight, and a baro sample 26 ms after the previous one
+static logDeltaState_t delta;
+static logGpsRecord_t nextRecord;
+static logBaroRecord_t baro = { { LOG_REC_BARO, sizeof(logBaroRecord_t) }, 4000000UL, 98803, LOG_NO_UTC };
+static logBaroRecord_t nextBaro;
+static uint8_t deltaOut[sizeof(logGpsRecord_t)];
+
+static void setup_delta(void) {
+    setup_format();
+    log_delta_reset(&delta);
+    log_delta_gps(&delta, &record, deltaOut);
+    log_delta_baro(&delta, &baro, deltaOut);
+    nextRecord = record;
+    nextRecord.milliseconds += 100;
+    nextRecord.lat_e7 += 268;
+    nextRecord.lon_e7 += 1150;
+    nextRecord.alt_cm += 30;
+    nextRecord.pressure_pa -= 4;
+    nextRecord.baro_alt_cm += 33;
+    nextRecord.micros += 100000;
+    nextRecord.fused_alt_cm += 31;
+    nextBaro = baro;
+    nextBaro.micros += 26000;
+    nextBaro.pressure_pa -= 2;
+}
+// worst case : every field changed, by large steps
+static void setup_delta_all(void) {
+    uint8_t* p = (uint8_t*)&nextRecord;
+
+    setup_delta();
+    for (uint8_t i = sizeof(logRecordTag_t); i < sizeof(nextRecord); i++) {
+        p[i] ^= 0x5A;
+    }
+}
+static void run_delta_gps(void) { log_delta_gps(&delta, &nextRecord, deltaOut); }
+static void run_delta_baro(void) { log_delta_baro(&delta, &nextBaro, deltaOut); }
+
+typedef struct {
+    const char *name; // in flash
+    void (*setup)(void);
+    void (*run)(void);
+} bench_t;
+
+static const char n_rmc[] PROGMEM = "gps_parse_nmea_char (RMC line)";
+static const char n_gga[] PROGMEM = "gps_parse_nmea_char (GGA line)";
+static const char n_vtg[] PROGMEM = "gps_parse_nmea_char (VTG line)";
+static const char n_gsa[] PROGMEM = "gps_parse_nmea_char (GSA line)";
+static const char n_gsv[] PROGMEM = "gps_parse_nmea_char (GSV, skipped)";
+static const char n_stream[] PROGMEM = "gps_read_serial_and_parse (fix)";
+static const char n_rx_byte[] PROGMEM = "gps_uart_rx_byte (RX ISR body)";
+static const char n_bmp_cycle[] PROGMEM = "updateBMP085Cycle";
+static const char n_bmp_read[] PROGMEM = "readBMP085All";
+static const char n_bmp_compensate[] PROGMEM = "compensateBMP085";
+static const char n_bmp_compensate_pow[] PROGMEM = "compensation with pow() (before)";
+static const char n_altitude[] PROGMEM = "baro_altitude_cm";
+static const char n_fusion_baro[] PROGMEM = "alt_fusion_baro";
+static const char n_fusion_gps[] PROGMEM = "alt_fusion_gps";
+static const char n_pps_utc[] PROGMEM = "pps_utc";
+static const char n_sched[] PROGMEM = "sched_run (4 idle tasks)";
+static const char n_filter_add[] PROGMEM = "pressure_filter_add (interval)";
+static const char n_filter_median[] PROGMEM = "pressure_filter_take (median 15)";
+static const char n_altitude_pow[] PROGMEM = "altitude with pow() (before)";
+static const char n_float8[] PROGMEM = "Print::print(float, 8)";
+static const char n_float2[] PROGMEM = "Print::print(float, 2)";
+static const char n_write[] PROGMEM = "writeGpsData";
+static const char n_write_baro[] PROGMEM = "writeBaroData";
+static const char n_fill[] PROGMEM = "fillGpsRecord";
+static const char n_format[] PROGMEM = "log_format_gps";
+static const char n_delta_gps[] PROGMEM = "log_delta_gps";
+static const char n_delta_gps_all[] PROGMEM = "log_delta_gps (every field)";
+static const char n_delta_baro[] PROGMEM = "log_delta_baro";
+
+static const bench_t benches[] = {
+    { n_rmc, setup_nothing, run_rmc },
+    { n_gga, setup_nothing, run_gga },
+    { n_vtg, setup_nothing, run_vtg },
+    { n_gsa, setup_nothing, run_gsa },
+    { n_gsv, setup_nothing, run_gsv },
+    { n_stream, setup_stream, run_stream },
+    { n_rx_byte, setup_rx_byte, run_rx_byte },
+    { n_bmp_cycle, setup_nothing, run_bmp_cycle },
+    { n_bmp_read, setup_nothing, run_bmp_read },
+    { n_bmp_compensate, setup_nothing, run_bmp_compensate },
+    { n_bmp_compensate_pow, setup_nothing, run_bmp_compensate_pow },
+    { n_altitude, setup_nothing, run_altitude },
+    { n_fusion_baro, setup_fusion, run_fusion_baro },
+    { n_fusion_gps, setup_fusion, run_fusion_gps },
+    { n_pps_utc, setup_pps, run_pps_utc },
+    { n_sched, setup_sched, run_sched },
+    { n_filter_add, setup_nothing, run_filter_add },
+    { n_filter_median, setup_filter_median, run_filter_take },
+    { n_altitude_pow, setup_nothing, run_altitude_pow },
+    { n_float8, setup_nothing, run_print_float8 },
+    { n_float2, setup_nothing, run_print_float2 },
+    { n_write, setup_write, run_write },
+    { n_write_baro, setup_write, run_write_baro },
+    { n_fill, setup_write, run_fill_record },
+    { n_format, setup_format, run_format },
+    { n_delta_gps, setup_delta, run_delta_gps },
+    { n_delta_gps_all, setup_delta_all, run_delta_gps },
+    { n_delta_baro, setup_delta, run_delta_baro },
+};
+
+/***************************************************
+* Measures
+***************************************************/
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint16_t stack;
+} result_t;
+
+static uint8_t *lowest_touched = (uint8_t *)RAMEND;
+
+static void paint_stack(void) {
+    uint8_t *p = &__heap_start;
+    uint8_t *top = (uint8_t *)(uintptr_t)SP - 32;
+    while (p < top) {
+        *p++ = STACK_PAINT;
+    }
+}
+
+static uint8_t *stack_low_mark(void) {
+    uint8_t *p = &__heap_start;
+    while (*p == STACK_PAINT && p < (uint8_t *)(uintptr_t)SP) {
+        p++;
+    }
+    return p;
+}
+
+static void __attribute__((noinline)) measure(void (*setup)(void), void (*run)(void), result_t *res) {
+    res->min = 0xFFFFFFFF;
+    res->max = 0;
+    res->total = 0;
+    res->stack = 0;
+
+    for (uint8_t i = 0; i < BENCH_RUNS; i++) {
+        setup();
+        paint_stack();
+        uint16_t sp = SP;
+        uint32_t t0 = bench_cycles();
+        run();
+        uint32_t t = bench_cycles() - t0;
+        uint8_t *low = stack_low_mark();
+
+        if (t < res->min) {
+            res->min = t;
+        }
+        if (t > res->max) {
+            res->max = t;
+        }
+        res->total += t;
+        if (sp - (uint16_t)(uintptr_t)low > res->stack) {
+            res->stack = sp - (uint16_t)(uintptr_t)low;
+        }
+        if (low < lowest_touched) {
+            lowest_touched = low;
+        }
+    }
+}
+
+/***************************************************
+* Output
+***************************************************/
+static void print_P(const char *s) {
+    char c;
+    while ((c = pgm_read_byte(s++)) != 0) {
+        console.print(c);
+    }
+}
+
+static void print_padded_P(const char *s, uint8_t width) {
+    uint8_t len = strlen_P(s);
+    print_P(s);
+    while (len++ < width) {
+        console.print(' ');
+    }
+}
+
+static void print_column(uint32_t value, uint8_t width) {
+    uint8_t digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10) {
+        digits++;
+    }
+    while (digits++ < width) {
+        console.print(' ');
+    }
+    console.print(value);
+}
+
+int main(void) {
+    result_t overhead, res;
+
+    avr_hal_begin();
+    beginBMP085(BMP085_ULTRALOWPOWER, 8);
+    logFile.begin("BENCH.CSV");
+
+    measure(setup_nothing, run_nothing, &overhead);
+
+    print_P(PSTR("\nfunction                          min cyc   mean cyc    max cyc  stack B\n"));
+    for (uint8_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        measure(benches[i].setup, benches[i].run, &res);
+        print_padded_P(benches[i].name, 32);
+        print_column(res.min - overhead.min, 10);
+        print_column(res.total / BENCH_RUNS - overhead.min, 11);
+        print_column(res.max - overhead.min, 11);
+        print_column(res.stack, 9);
+        console.print('\n');
+    }
+
+    // datasheet example : 150 (0.1 degC), 69964 Pa, for both computations
+    print_P(PSTR("\nbmp085 check : "));
+    console.print(bmp.temperature);
+    print_P(PSTR(" dC "));
+    console.print((long)bmp.pressure);
+    print_P(PSTR(" Pa, with pow() "));
+    console.print(powTemperature, 1);
+    print_P(PSTR(" degC "));
+    console.print((long)powPressure);
+    print_P(PSTR(" Pa\n"));
+    // 3016.85 m at 69964 Pa
+    print_P(PSTR("altitude check : "));
+    console.print(altitudeCm);
+    print_P(PSTR(" cm, with pow() "));
+    console.print(powAltitude, 2);
+    print_P(PSTR(" m\n"));
+
+    print_P(PSTR("ram : static "));
+    console.print((unsigned)(&__heap_start - (uint8_t *)RAMSTART));
+    print_P(PSTR(" B, high-water "));
+    console.print((unsigned)((uint8_t *)RAMEND + 1 - (uint8_t *)RAMSTART)
+                  - (unsigned)(lowest_touched - &__heap_start));
+    print_P(PSTR(" B of "));
+    console.print((unsigned)(RAMEND + 1 - RAMSTART));
+    console.print('\n');
+
+    // simavr quits on sleep with interrupts off
+    cli();
+    sleep_cpu();
+    return 0;
+}
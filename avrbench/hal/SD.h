@@ -0,0 +1,62 @@
+/*
+ * SD.h (AVR benchmark stub)
+ *
+ *  Card that swallows everything : only the cost of formatting and of the
+ *  calls through Print is left in the measures.
+ *
+ */
+
+#ifndef AVRBENCH_SD_H_
+#define AVRBENCH_SD_H_
+
+#include "Arduino.h"
+
+#define O_READ   0x01
+#define O_WRITE  0x02
+#define O_APPEND 0x04
+#define O_CREAT  0x10
+#define O_TRUNC  0x40
+
+#define FILE_READ  O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT)
+
+class File : public Stream {
+private:
+    boolean _open;
+    uint32_t _size;
+
+public:
+    File(void) : _open(false), _size(0) {}
+    File(boolean open) : _open(open), _size(0) {}
+
+    virtual size_t write(uint8_t c) { (void)c; _size++; return 1; }
+    virtual size_t write(const uint8_t *buf, size_t size) { (void)buf; _size += size; return size; }
+    using Print::write;
+    virtual int read(void) { return -1; }
+    virtual int peek(void) { return -1; }
+    virtual int available(void) { return 0; }
+    virtual void flush(void) {}
+    boolean seek(uint32_t pos) { return pos <= _size; }
+    uint32_t position(void) { return _size; }
+    uint32_t size(void) { return _size; }
+    void close(void) { _open = false; }
+    const char *name(void) { return ""; }
+    operator bool() { return _open; }
+};
+
+class SDClass {
+public:
+    boolean begin(uint8_t csPin = SS) { (void)csPin; return true; }
+    File open(const char *filename, uint8_t mode = FILE_READ) {
+        (void)filename;
+        (void)mode;
+        return File(true);
+    }
+    boolean exists(const char *filepath) { (void)filepath; return true; }
+    boolean mkdir(const char *filepath) { (void)filepath; return true; }
+    boolean remove(const char *filepath) { (void)filepath; return true; }
+};
+
+extern SDClass SD;
+
+#endif /* AVRBENCH_SD_H_ */
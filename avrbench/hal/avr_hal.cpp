@@ -0,0 +1,152 @@
+/*
+ * avr_hal.cpp
+ *
+ *  See avr_hal.h.
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "SD.h"
+#include "Twi.h"
+#include "avr_hal.h"
+
+#define BMP085_ADDR 0x77
+
+/***************************************************
+* DATA
+***************************************************/
+SDClass SD;
+Console console;
+
+static volatile uint16_t timer1_overflows = 0;
+
+static uint8_t bmp_regs[0x100 - 0xAA];
+static uint8_t bmp_pointer = 0;
+
+/***************************************************
+* Cycle counter
+***************************************************/
+ISR(TIMER1_OVF_vect) {
+    timer1_overflows++;
+}
+
+uint32_t bench_cycles(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t low = TCNT1;
+    uint16_t high = timer1_overflows;
+    if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+        // overflow pending, not yet counted by the ISR
+        high++;
+    }
+    SREG = sreg;
+    return ((uint32_t)high << 16) | low;
+}
+
+static void bmp_set16(uint8_t reg, uint16_t value) {
+    bmp_regs[reg - 0xAA] = value >> 8;
+    bmp_regs[reg - 0xAA + 1] = value & 0xFF;
+}
+
+void avr_hal_begin(void) {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10); // clk/1
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1);
+    TIMSK1 = _BV(TOIE1);
+
+    //Datasheet example calibration and raw values (UT 27898, UP 23843 at oss 0)
+    bmp_set16(0xAA, (uint16_t)408);
+    bmp_set16(0xAC, (uint16_t)-72);
+    bmp_set16(0xAE, (uint16_t)-14383);
+    bmp_set16(0xB0, (uint16_t)32741);
+    bmp_set16(0xB2, (uint16_t)32757);
+    bmp_set16(0xB4, (uint16_t)23153);
+    bmp_set16(0xB6, (uint16_t)6190);
+    bmp_set16(0xB8, (uint16_t)4);
+    bmp_set16(0xBA, (uint16_t)-32768);
+    bmp_set16(0xBC, (uint16_t)-8711);
+    bmp_set16(0xBE, (uint16_t)2868);
+    bmp_regs[0xD0 - 0xAA] = 0x55;
+    bmp_set16(0xF6, 27898);
+    bmp_regs[0xF8 - 0xAA] = 0;
+
+    sei();
+}
+
+/***************************************************
+* Core functions
+***************************************************/
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    (void)pin;
+    (void)val;
+}
+
+int digitalRead(uint8_t pin) {
+    (void)pin;
+    return HIGH;
+}
+
+unsigned long micros(void) {
+    return bench_cycles() / (F_CPU / 1000000UL);
+}
+
+unsigned long millis(void) {
+    return bench_cycles() / (F_CPU / 1000UL);
+}
+
+void delay(unsigned long ms) {
+    (void)ms;
+}
+
+void delayMicroseconds(unsigned int us) {
+    (void)us;
+}
+
+void interrupts(void) {
+    sei();
+}
+
+void noInterrupts(void) {
+    cli();
+}
+
+size_t Console::write(uint8_t c) {
+    GPIOR0 = c;
+    return 1;
+}
+
+/***************************************************
+* TWI (TWI_EXTERNAL_HW) : transactions complete at once
+***************************************************/
+void twi_hw_begin(void) {
+}
+
+void twi_hw_start(twiTransaction_t* t) {
+    if (t->txLength > 0) {
+        bmp_pointer = t->txData[0];
+        if (t->txLength > 1 && bmp_pointer == 0xF4 && t->txData[1] != 0x2E) {
+            // pressure conversion : 23843 at oss 0, scaled to the requested one
+            uint8_t oss = t->txData[1] >> 6;
+            uint32_t up24 = (23843UL << oss) << (8 - oss);
+            bmp_regs[0xF6 - 0xAA] = up24 >> 16;
+            bmp_regs[0xF7 - 0xAA] = up24 >> 8;
+            bmp_regs[0xF8 - 0xAA] = up24;
+        } else if (t->txLength > 1 && bmp_pointer == 0xF4) {
+            bmp_set16(0xF6, 27898);
+        }
+    }
+    for (uint8_t i = 0; i < t->rxLength; i++) {
+        uint8_t reg = bmp_pointer++;
+        t->rxData[i] = reg >= 0xAA ? bmp_regs[reg - 0xAA] : 0;
+    }
+    twi_hw_done(TWI_OK);
+}
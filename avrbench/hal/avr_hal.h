@@ -0,0 +1,33 @@
+/*
+ * avr_hal.h
+ *
+ *  Bare AVR stand-ins for the Arduino core pieces used by the logger, for the
+ *  cycle benchmarks run under simavr. The interfaces are the ones of the
+ *  host mock headers (host/hal), the implementations are minimal :
+ *   - Timer1 runs at the CPU clock and counts cycles,
+ *   - the TWI answers at once, as a BMP085 holding the datasheet example
+ *     values,
+ *   - the EOC pin always reads HIGH.
+ *
+ */
+
+#ifndef AVR_HAL_H_
+#define AVR_HAL_H_
+
+#include "Arduino.h"
+
+// Cycles since avr_hal_begin().
+uint32_t bench_cycles(void);
+
+void avr_hal_begin(void);
+
+// Output of the simavr console (GPIOR0).
+class Console : public Print {
+public:
+    virtual size_t write(uint8_t c);
+    using Print::write;
+};
+
+extern Console console;
+
+#endif /* AVR_HAL_H_ */
@@ -0,0 +1,95 @@
+/*
+ * altitude_table.cpp
+ *
+ *  Table generator and error check of the barometric altitude engine
+ *  (BaroAltitude.h).
+ *
+ *  usage : altitude_table -g    prints the table of BaroAltitude.cpp
+ *          altitude_table       compares baro_altitude_cm() to the exact
+ *                               formula (double) on every Pa of the table
+ *                               range, for a few references, and times it
+ *                               against the float pow() computation
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "BaroAltitude.h"
+
+static const int32_t references[] = { 95000, 98000, 101325, 103500, 108000 };
+#define TIMED_CALLS 10000000
+
+static double exact_m(int32_t pressure, int32_t reference) {
+    return 44330.0 * (1.0 - pow((double)pressure / reference, 0.1903));
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void generate(void) {
+    for (int i = 0; i < BARO_ALT_POINTS; i++) {
+        int32_t pressure = BARO_ALT_PA_MIN + ((int32_t)i << BARO_ALT_STEP_SHIFT);
+        printf("%s%lu%s", i % 6 == 0 ? "    " : " ",
+               (unsigned long)lround(4433000.0 * pow(pressure / 101325.0, 0.1903)),
+               i == BARO_ALT_POINTS - 1 ? "" : ",");
+        if (i % 6 == 5 || i == BARO_ALT_POINTS - 1) {
+            printf("\n");
+        }
+    }
+}
+
+static void check(void) {
+    printf("%-10s %14s %14s %22s\n", "p0 (Pa)", "max err (m)", "at (Pa)", "max err >90000 Pa (m)");
+    for (size_t r = 0; r < sizeof(references) / sizeof(references[0]); r++) {
+        double worst = 0, worst_high = 0;
+        int32_t worst_at = 0;
+
+        baro_altitude_reference(references[r]);
+        for (int32_t p = BARO_ALT_PA_MIN; p <= BARO_ALT_PA_MAX; p++) {
+            double err = fabs(baro_altitude_cm(p) / 100.0 - exact_m(p, references[r]));
+            if (err > worst) {
+                worst = err;
+                worst_at = p;
+            }
+            if (p > 90000 && err > worst_high) {
+                worst_high = err;
+            }
+        }
+        printf("%-10d %14.3f %14d %22.3f\n", references[r], worst, worst_at, worst_high);
+    }
+
+    // volatile sinks : keep both loops
+    volatile int32_t sink_cm = 0;
+    volatile float sink_m = 0;
+    uint64_t t0 = now_ns();
+    for (int32_t i = 0; i < TIMED_CALLS; i++) {
+        sink_cm = baro_altitude_cm(BARO_ALT_PA_MIN + (i & 0xFFFF));
+    }
+    uint64_t t1 = now_ns();
+    for (int32_t i = 0; i < TIMED_CALLS; i++) {
+        sink_m = 44330 * (1.0 - pow(((float)(BARO_ALT_PA_MIN + (i & 0xFFFF))) / 101325.0f, 0.1903));
+    }
+    uint64_t t2 = now_ns();
+    (void)sink_cm;
+    (void)sink_m;
+    printf("\nhost time : baro_altitude_cm %.1f ns, pow() %.1f ns\n",
+           (double)(t1 - t0) / TIMED_CALLS, (double)(t2 - t1) / TIMED_CALLS);
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "-g") == 0) {
+        generate();
+    } else if (argc == 1) {
+        check();
+    } else {
+        fprintf(stderr, "usage : %s [-g]\n", argv[0]);
+        return 2;
+    }
+    return 0;
+}
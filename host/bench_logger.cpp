@@ -0,0 +1,891 @@
+/*
+ * bench_logger.cpp
+ *
+ *  Runs the logger sketch (setup() then loop()) on the host mock HAL, fed
+ *  with a recorded NMEA byte stream and a scripted BMP085, and reports :
+ *   - pipeline throughput (sentences/s and bytes/s of host time spent in loop()),
+ *   - host time per call of the profiled steps (see Profile.h),
+ *   - worst loop() duration on the virtual clock, i.e. the stall the board
+ *     would see because of I2C and SD card latencies,
+ *   - the noise of the barometric and fused altitudes, the vertical speed,
+ *   - BMP085 pressure samples/s, the jitter of their timestamps (interval
+ *     between samples, lag behind the real end of conversion) and the time
+ *     the sensor sat idle,
+ *   - records/s on the virtual clock (with -f, the sustained logging rate),
+ *   - the SD card busy time, its worst operation and its write rate (log
+ *     bytes per second of busy time),
+ *   - the bytes per GPS and baro record as written (CSV line, binary or
+ *     delta record), and the card wear (blocks written per hour),
+ *   - bytes lost on the GPS RX buffer, and a hash of each written log file
+ *     to catch output regressions,
+ *   - per scheduler task (Scheduler.h), its runs, deadline misses and worst
+ *     lateness,
+ *   - with -k, the cost of the recovery of the log file after a power cut,
+ *   - with -P, the error of the UTC stamps of the binary baro records
+ *     against the virtual clock (PPS_PIN build).
+ *
+ *  usage : bench_logger [options] <nmea file>
+ *     -b <file>  BMP085 script, "UT UP19" per line (default : datasheet values)
+ *     -r <n>     replay the NMEA stream n times (default 1)
+ *     -e <hz>    GPS output rate : each epoch (group of sentences sharing a
+ *                UTC time) starts 1/hz s after the previous one (default 1,
+ *                0 sends the stream back to back)
+ *     -f         flood : deliver bytes as fast as they are read, ignoring baud rate
+ *     -l <us>    virtual time of one loop() pass, besides peripherals (default 100)
+ *     -s         disable SD card busy spikes
+ *     -d <dir>   copy the card content to a host directory when done
+ *     -t <n>     BMP085 temperature conversion every n pressure ones
+ *                (default : the logger's BMP_TEMPERATURE_EVERY)
+ *     -p <m:n>   pressure filter mode m with its parameter n, see
+ *                PressureFilter.h (default : the logger's BMP_FILTER)
+ *     -P         GPS PPS on pin 2, an edge at the start of each epoch
+ *                (needs -e 1) : the first one is the UTC second of the
+ *                first epoch of the stream
+ *     -c <ppm>   board clock error, for millis() and micros()
+ *     -g <baud>  speed of the GPS module at power on (default 9600), as
+ *                left by a previous boot
+ *     -w <us>    more work : a background task of that duration, after the
+ *                logger ones
+ *     -k         power cut at the end, during the last card write, then the
+ *                log file is opened again, a binary header record written
+ *                and the file closed : virtual time and block reads of the
+ *                opening, i.e. of the recovery scan (binary LOG_RAW build)
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "AltitudeFusion.h"
+#include "BMP085.h"
+#include "GPSMTK339.h"
+#include "LogDelta.h"
+#include "LogFile.h"
+#include "LogFormat.h"
+#include "LogRecord.h"
+#include "log_frames.h"
+#include "Pps.h"
+#include "PressureFilter.h"
+#include "Profile.h"
+#include "SD.h"
+#include "Scheduler.h"
+#include "mock_hal.h"
+
+/***************************************************
+* Profiling
+***************************************************/
+typedef struct {
+    const char *name;
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t start_ns;
+} profileSlot_t;
+
+static profileSlot_t slots[PROFILE_COUNT] = {
+    { "gps_read_serial_and_parse_nmea", 0, 0, 0, 0, 0 },
+    { "updateBMP085Cycle",              0, 0, 0, 0, 0 },
+    { "readBMP085All",                  0, 0, 0, 0, 0 },
+    { "alt_fusion_baro",                0, 0, 0, 0, 0 },
+    { "writeGpsData",                   0, 0, 0, 0, 0 },
+    { "writeBaroData",                  0, 0, 0, 0, 0 },
+    { "logFile.service",                0, 0, 0, 0, 0 },
+};
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void profile_begin(profileId_t id) {
+    slots[id].start_ns = host_ns();
+}
+
+void profile_end(profileId_t id) {
+    uint64_t ns = host_ns() - slots[id].start_ns;
+    profileSlot_t *s = &slots[id];
+    if (s->calls == 0 || ns < s->min_ns) {
+        s->min_ns = ns;
+    }
+    if (ns > s->max_ns) {
+        s->max_ns = ns;
+    }
+    s->total_ns += ns;
+    s->calls++;
+}
+
+/***************************************************
+* Scheduler
+***************************************************/
+extern schedTask_t taskBmp, taskGps, taskRecord, taskLog; // GpsLogger.cpp
+
+static unsigned extra_us;
+
+static boolean run_extra(void) {
+    mock_advance_us(extra_us);
+    return true;
+}
+
+static schedTask_t taskExtra = { run_extra, SCHED_EVERY_PASS, 0xFFFFFFFFUL, SCHED_BACKGROUND };
+
+/***************************************************
+* BMP085 sample times
+***************************************************/
+typedef struct {
+    uint64_t count;
+    unsigned long last;    // timestamp of the last sample
+    double interval_sum;   // us
+    double interval_sq_sum;
+    double interval_max;
+    double lag_sum;        // timestamp - real end of conversion, us
+    double lag_max;
+} sampleTimes_t;
+
+static sampleTimes_t samples;
+
+/*
+ * Altitude noise : sd of the differences between successive altitudes
+ * (samples, then 1 s means) / sqrt(2). Differencing drops the slow climb.
+ * A step of the reference (hpa0, moved by the altitude fusion) is not
+ * noise : the differences across it are left out.
+ */
+typedef struct {
+    uint64_t reads;        // altitudes seen
+    int32_t reference;
+    int32_t last_cm;
+    double diff_sum;
+    double diff_sq_sum;
+    uint64_t diffs;
+    uint64_t second;       // virtual second of the running mean
+    double mean_sum;
+    unsigned mean_count;
+    double last_mean;
+    bool has_mean;
+    double mean_diff_sum;
+    double mean_diff_sq_sum;
+    uint64_t mean_diffs;
+} altitudeNoise_t;
+
+static uint64_t reads_seen; // readBMP085All calls
+static altitudeNoise_t noise;
+static altitudeNoise_t fused; // AltitudeFusion.h, same samples
+static double vspeed_sum;
+static double vspeed_sq_sum;
+
+extern bmpData_t bmp085Data; // GpsLogger.cpp
+
+static double noise_sd(double sum, double sq_sum, uint64_t n) {
+    if (n < 2) {
+        return 0;
+    }
+    double mean = sum / n;
+    double var = sq_sum / n - mean * mean;
+    return sqrt(var > 0 ? var : 0) / sqrt(2.0);
+}
+
+// A new altitude (cm) at the virtual second `second`, against reference.
+static void add_altitude(altitudeNoise_t *n, int32_t cm, uint64_t second, int32_t reference) {
+    if (n->reads > 0 && reference != n->reference) {
+        n->reads = 0;
+        n->has_mean = false;
+        n->mean_sum = 0;
+        n->mean_count = 0;
+    }
+    n->reference = reference;
+    if (n->reads > 0) {
+        double d = (cm - n->last_cm) / 100.0;
+        n->diff_sum += d;
+        n->diff_sq_sum += d * d;
+        n->diffs++;
+    }
+    if (second != n->second && n->mean_count > 0) {
+        double mean = n->mean_sum / n->mean_count;
+        if (n->has_mean) {
+            double d = mean - n->last_mean;
+            n->mean_diff_sum += d;
+            n->mean_diff_sq_sum += d * d;
+            n->mean_diffs++;
+        }
+        n->last_mean = mean;
+        n->has_mean = true;
+        n->mean_sum = 0;
+        n->mean_count = 0;
+    }
+    n->second = second;
+    n->mean_sum += cm / 100.0;
+    n->mean_count++;
+    n->last_cm = cm;
+    n->reads++;
+}
+
+// After each loop() : picks up a new altitude, if any, and the fused one.
+static void track_altitude(void) {
+    uint64_t reads = slots[PROFILE_BMP_READ].calls;
+    uint64_t second = mock_now_us() / 1000000;
+
+    if (reads == reads_seen) {
+        return;
+    }
+    reads_seen = reads;
+    add_altitude(&noise, bmp085Data.altitude, second, lround(bmp085Data.hpa0));
+    // the first GPS altitude sets the fused one
+    add_altitude(&fused, alt_fusion_altitude_cm(), second, slots[PROFILE_WRITE_LOG].calls > 0);
+    double vz = alt_fusion_vspeed_cms() / 100.0;
+    vspeed_sum += vz;
+    vspeed_sq_sum += vz * vz;
+}
+
+// After each loop() : picks up a new sample timestamp, if any.
+static void track_bmp_sample(void) {
+    unsigned long stamp = getBMP085SampleMicros();
+    const mock_bmp085_stats_t *bmp = mock_bmp085_stats();
+
+    if (bmp->pressure_conversions == 0 || stamp == samples.last) {
+        return;
+    }
+    if (samples.count > 0) {
+        double interval = (double)(uint32_t)(stamp - samples.last);
+        samples.interval_sum += interval;
+        samples.interval_sq_sum += interval * interval;
+        if (interval > samples.interval_max) {
+            samples.interval_max = interval;
+        }
+    }
+    // a long pass may have started the next conversion already
+    uint64_t end_us = bmp->last_pressure_end_us <= mock_now_us() ? bmp->last_pressure_end_us
+            : bmp->prev_pressure_end_us;
+    double lag = (double)(int32_t)(stamp - (uint32_t)mock_board_us(end_us));
+    samples.lag_sum += lag;
+    if (lag > samples.lag_max) {
+        samples.lag_max = lag;
+    }
+    samples.last = stamp;
+    samples.count++;
+}
+
+/***************************************************
+* Input files
+***************************************************/
+static bool load_file(const char *path, std::vector<uint8_t> *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        out->insert(out->end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool load_bmp_script(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    std::vector<int32_t> ut, up19;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        long a, b;
+        if (line[0] != '#' && sscanf(line, "%ld %ld", &a, &b) == 2) {
+            ut.push_back((int32_t)a);
+            up19.push_back((int32_t)b);
+        }
+    }
+    fclose(f);
+    if (ut.empty()) {
+        return false;
+    }
+    mock_bmp085_set_script(&ut[0], &up19[0], ut.size());
+    return true;
+}
+
+/*
+ * Splits an NMEA stream into epochs : a new epoch starts with each
+ * sentence whose UTC time field differs from the previous timed one.
+ * Returns the offsets of the first byte of each epoch.
+ */
+static std::vector<size_t> split_epochs(const std::vector<uint8_t> &nmea) {
+    std::vector<size_t> starts;
+    std::string epoch_time;
+    size_t i = 0;
+
+    while (i < nmea.size()) {
+        size_t eol = i;
+        while (eol < nmea.size() && nmea[eol] != '\n') {
+            eol++;
+        }
+        std::string line((const char *)&nmea[i], eol - i);
+        std::string id = line.size() > 6 ? line.substr(3, 3) : "";
+        if (line[0] == '$' && (id == "GGA" || id == "RMC" || id == "GLL" || id == "ZDA")) {
+            size_t f1 = line.find(',');
+            size_t f2 = line.find(',', f1 + 1);
+            std::string t = line.substr(f1 + 1, f2 - f1 - 1);
+            if (id == "GLL") {
+                t.clear(); // time is field 5, only used to chain sentences
+            }
+            if (!t.empty() && t != epoch_time) {
+                epoch_time = t;
+                starts.push_back(i);
+            }
+        }
+        if (starts.empty()) {
+            starts.push_back(i);
+        }
+        i = eol + 1;
+    }
+    return starts;
+}
+
+/*
+ * UTC second of day of the first timed sentence from offset start, -1 if
+ * none.
+ */
+static long epoch_utc_second(const std::vector<uint8_t> &nmea, size_t start) {
+    std::string text((const char *)&nmea[start], nmea.size() - start);
+    size_t i = 0;
+
+    while (i < text.size()) {
+        size_t eol = text.find('\n', i);
+        std::string line = text.substr(i, eol == std::string::npos ? std::string::npos : eol - i);
+        std::string id = line.size() > 6 ? line.substr(3, 3) : "";
+        unsigned h, m, sec;
+        if (line[0] == '$' && (id == "GGA" || id == "RMC" || id == "ZDA")
+                && sscanf(line.c_str() + 7, "%2u%2u%2u", &h, &m, &sec) == 3) {
+            return h * 3600L + m * 60L + sec;
+        }
+        if (eol == std::string::npos) {
+            break;
+        }
+        i = eol + 1;
+    }
+    return -1;
+}
+
+typedef struct {
+    uint64_t stamped;   // baro records with a UTC
+    uint64_t records;
+    double error_sum;   // us
+    double error_max;   // absolute, us
+} ppsErrors_t;
+
+/*
+ * UTC of the baro records of a binary log against the true UTC of their
+ * micros() : edge_us (virtual) is the UTC second utc0. The run is shorter
+ * than the micros() wrap.
+ */
+static void pps_errors(const uint8_t *data, size_t len, uint64_t edge_us, long utc0,
+                       int32_t ppm, ppsErrors_t *out) {
+    size_t pos = 0;
+
+    if (len < sizeof(logHeaderRecord_t) || data[0] != LOG_REC_HEADER) {
+        return;
+    }
+    while (len - pos >= sizeof(logRecordTag_t)) {
+        logRecordTag_t tag;
+        memcpy(&tag, data + pos, sizeof(tag));
+        if (tag.size < sizeof(tag) || len - pos < tag.size) {
+            break;
+        }
+        if (tag.type == LOG_REC_BARO && tag.size >= sizeof(logBaroRecord_t)) {
+            logBaroRecord_t record;
+            memcpy(&record, data + pos, sizeof(record));
+            out->records++;
+            if (record.utc_dms != LOG_NO_UTC) {
+                double virtual_us = record.micros * 1e6 / (1e6 + ppm);
+                double truth = fmod(utc0 * 1e6 + (virtual_us - edge_us), PPS_DAY_DMS * 100.0);
+                double error = record.utc_dms * 100.0 - truth;
+                out->stamped++;
+                out->error_sum += error;
+                if (fabs(error) > out->error_max) {
+                    out->error_max = fabs(error);
+                }
+            }
+        }
+        pos += tag.size;
+    }
+}
+
+typedef struct {
+    double alt;     // m
+    long hpa0;      // Pa
+} loggedAltitude_t;
+
+/*
+ * Barometric altitudes of the GPS records of a log, CSV or binary.
+ */
+static void logged_altitudes(const uint8_t *data, size_t len, std::vector<loggedAltitude_t> *out) {
+    if (len >= sizeof(logHeaderRecord_t) && data[0] == LOG_REC_HEADER
+            && memcmp(data + 2, LOG_MAGIC, 4) == 0) {
+        size_t pos = 0;
+        while (len - pos >= sizeof(logRecordTag_t)) {
+            logRecordTag_t tag;
+            memcpy(&tag, data + pos, sizeof(tag));
+            if (tag.size < sizeof(tag) || len - pos < tag.size) {
+                break;
+            }
+            if (tag.type == LOG_REC_GPS && tag.size >= sizeof(logGpsRecord_t)) {
+                logGpsRecord_t record;
+                memcpy(&record, data + pos, sizeof(record));
+                loggedAltitude_t a = { record.baro_alt_cm / 100.0, (long)record.hpa0_pa };
+                out->push_back(a);
+            }
+            pos += tag.size;
+        }
+        return;
+    }
+    // CSV : hpa0 and alt, 13th and 14th columns, column lines skipped
+    std::string text((const char *)data, len);
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t eol = text.find('\n', start);
+        std::string line = text.substr(start, eol == std::string::npos ? std::string::npos : eol - start);
+        start = eol == std::string::npos ? text.size() : eol + 1;
+        size_t field = 0;
+        size_t hpa0 = std::string::npos;
+        for (int i = 0; i < 13 && field != std::string::npos; i++) {
+            hpa0 = field;
+            field = line.find('|', field);
+            if (field != std::string::npos) {
+                field++;
+            }
+        }
+        if (field != std::string::npos && line.compare(0, 3, "Fix") != 0) {
+            loggedAltitude_t a = { atof(line.c_str() + field), atol(line.c_str() + hpa0) };
+            out->push_back(a);
+        }
+    }
+}
+
+/*
+ * Log stream of a card file : the payloads of its frames for a LOG_RAW
+ * logger, segments end to end (segment count to *segments), else the file
+ * as it is (0 segments).
+ */
+static std::vector<uint8_t> log_stream(const char *path, size_t *segment_count) {
+    size_t len;
+    const uint8_t *data = mock_sd_file(path, &len);
+    logSegments_t segments;
+    std::vector<uint8_t> stream;
+
+    *segment_count = 0;
+    if (!log_frames_unpack(data, len, &segments)) {
+        return std::vector<uint8_t>(data, data + len);
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        stream.insert(stream.end(), segments[i].begin(), segments[i].end());
+    }
+    *segment_count = segments.size();
+    return stream;
+}
+
+/*
+ * Binary log stream with its delta records expanded (LogDelta.h), to be
+ * read like a plain one. Other streams as they are.
+ */
+static std::vector<uint8_t> expand_deltas(const std::vector<uint8_t> &stream) {
+    logDeltaState_t deltas;
+    std::vector<uint8_t> out;
+    uint8_t full[LOG_DELTA_FULL_MAX];
+    size_t pos = 0;
+
+    if (stream.empty() || stream[0] != LOG_REC_HEADER) {
+        return stream;
+    }
+    log_delta_reset(&deltas);
+    while (stream.size() - pos >= sizeof(logRecordTag_t)) {
+        uint8_t size = stream[pos + 1];
+        if (size < sizeof(logRecordTag_t) || stream.size() - pos < size) {
+            break;
+        }
+        uint8_t full_size = log_delta_decode(&deltas, &stream[pos], full);
+        if (full_size == 0) {
+            break;
+        }
+        out.insert(out.end(), full, full + full_size);
+        pos += size;
+    }
+    return out;
+}
+
+typedef struct {
+    uint64_t gps_bytes;
+    uint64_t gps_records;
+    uint64_t baro_bytes;
+    uint64_t baro_records;
+} recordSizes_t;
+
+/*
+ * Bytes of the GPS and baro records of a log stream, as written : binary
+ * records (delta ones included) or CSV lines.
+ */
+static void record_sizes(const std::vector<uint8_t> &stream, recordSizes_t *out) {
+    size_t pos = 0;
+
+    if (!stream.empty() && stream[0] == LOG_REC_HEADER) {
+        while (stream.size() - pos >= sizeof(logRecordTag_t)) {
+            uint8_t type = stream[pos];
+            uint8_t size = stream[pos + 1];
+            if (size < sizeof(logRecordTag_t) || stream.size() - pos < size) {
+                break;
+            }
+            if (type == LOG_REC_GPS || type == LOG_REC_GPS_DELTA) {
+                out->gps_bytes += size;
+                out->gps_records++;
+            } else if (type == LOG_REC_BARO || type == LOG_REC_BARO_DELTA) {
+                out->baro_bytes += size;
+                out->baro_records++;
+            }
+            pos += size;
+        }
+        return;
+    }
+    while (pos < stream.size()) {
+        const uint8_t *eol = (const uint8_t *)memchr(&stream[pos], '\n', stream.size() - pos);
+        size_t len = eol == NULL ? stream.size() - pos : eol + 1 - &stream[pos];
+        if (len > 2 && stream[pos] == LOG_TEXT_BARO && stream[pos + 1] == LOG_TEXT_SEPARATOR) {
+            out->baro_bytes += len;
+            out->baro_records++;
+        } else if (len > 1 && stream[pos] >= '0' && stream[pos] <= '9' && stream[pos + 1] == LOG_TEXT_SEPARATOR) {
+            out->gps_bytes += len;
+            out->gps_records++;
+        }
+        pos += len;
+    }
+}
+
+static uint32_t fnv1a(const uint8_t *data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage : %s [-b bmp_script] [-r repeat] [-e hz] [-f] [-l loop_us] [-s] [-d dump_dir] [-t n] [-p mode:param] [-P] [-c ppm] [-g baud] [-w us] [-k] <nmea file>\n", name);
+    exit(2);
+}
+
+/***************************************************
+* Main
+***************************************************/
+int main(int argc, char **argv) {
+    const char *bmp_script = NULL;
+    const char *dump_dir = NULL;
+    unsigned repeat = 1;
+    unsigned rate_hz = 1;
+    unsigned loop_us = 100;
+    bool flood = false;
+    bool no_spikes = false;
+    unsigned temperature_every = 0;
+    unsigned filter_mode = 0, filter_param = 0;
+    bool filter_set = false;
+    bool pps = false;
+    int32_t clock_ppm = 0;
+    unsigned long gps_baud = 0;
+    bool power_cut = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:r:e:fl:sd:t:p:Pc:g:w:k")) != -1) {
+        switch (opt) {
+            case 'b': bmp_script = optarg; break;
+            case 'r': repeat = (unsigned)atoi(optarg); break;
+            case 'e': rate_hz = (unsigned)atoi(optarg); break;
+            case 'f': flood = true; break;
+            case 'l': loop_us = (unsigned)atoi(optarg); break;
+            case 's': no_spikes = true; break;
+            case 'd': dump_dir = optarg; break;
+            case 't': temperature_every = (unsigned)atoi(optarg); break;
+            case 'p':
+                if (sscanf(optarg, "%u:%u", &filter_mode, &filter_param) != 2) {
+                    usage(argv[0]);
+                }
+                filter_set = true;
+                break;
+            case 'P': pps = true; break;
+            case 'c': clock_ppm = atoi(optarg); break;
+            case 'g': gps_baud = strtoul(optarg, NULL, 10); break;
+            case 'w': extra_us = (unsigned)atoi(optarg); break;
+            case 'k': power_cut = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || (pps && (rate_hz != 1 || flood))) {
+        usage(argv[0]);
+    }
+
+    std::vector<uint8_t> nmea;
+    if (!load_file(argv[optind], &nmea) || nmea.empty()) {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    std::vector<size_t> epochs = split_epochs(nmea);
+    long utc0 = epoch_utc_second(nmea, epochs[0]);
+    if (pps && utc0 < 0) {
+        fprintf(stderr, "no UTC time in %s\n", argv[optind]);
+        return 1;
+    }
+
+    mock_reset();
+    mock_set_clock_ppm(clock_ppm);
+    if (gps_baud > 0) {
+        mock_gps_set_baud(gps_baud);
+    }
+    if (bmp_script && !load_bmp_script(bmp_script)) {
+        fprintf(stderr, "cannot read BMP085 script %s\n", bmp_script);
+        return 1;
+    }
+    if (no_spikes) {
+        mock_sd_latency()->spike_us = 0;
+    }
+
+    // The card is expected to be prepared with the log folder.
+    SD.mkdir("LOGS_GPS");
+
+    setup();
+    if (temperature_every > 0) {
+        setBMP085TemperatureRate(temperature_every, 1000);
+    }
+    if (filter_set) {
+        pressure_filter_begin(filter_mode, filter_param);
+    }
+    if (extra_us > 0) {
+        sched_add(&taskExtra);
+    }
+
+    uint64_t loops = 0;
+    uint64_t loop_ns = 0;
+    uint64_t worst_loop_us = 0;
+    uint64_t start_us = mock_now_us();
+
+    if (pps) {
+        mock_pps_start(2, start_us);
+    }
+    mock_serial_set_flood(flood);
+    for (unsigned r = 0; r < repeat; r++) {
+        for (size_t e = 0; e < epochs.size(); e++) {
+            size_t end = e + 1 < epochs.size() ? epochs[e + 1] : nmea.size();
+            uint64_t at_us = start_us;
+            if (rate_hz > 0) {
+                at_us += ((uint64_t)r * epochs.size() + e) * 1000000 / rate_hz;
+            }
+            mock_serial_load(&nmea[epochs[e]], end - epochs[e], at_us);
+        }
+    }
+
+    // a few more passes once everything is sent, for the received bytes
+    unsigned drain_passes = 16;
+    for (;;) {
+        mock_advance_us(loop_us);
+        uint64_t v0 = mock_now_us();
+        uint64_t t0 = host_ns();
+        loop();
+        loop_ns += host_ns() - t0;
+        uint64_t stall = mock_now_us() - v0;
+        if (stall > worst_loop_us) {
+            worst_loop_us = stall;
+        }
+        loops++;
+        track_bmp_sample();
+        track_altitude();
+        if (mock_serial_done() && drain_passes-- == 0) {
+            break;
+        }
+    }
+    const mock_sd_stats_t *sd = mock_sd_stats();
+    double virtual_s = (mock_now_us() - start_us) / 1e6;
+    uint64_t recovery_us = 0;
+    uint32_t recovery_reads = 0;
+    bool recovered = false;
+    if (power_cut) {
+        // what is still buffered is lost, then the logger boots on the same card
+        std::string path = mock_sd_file_name(0);
+        mock_sd_power_cut();
+        uint64_t t0 = mock_now_us();
+        uint32_t reads0 = sd->block_reads;
+        recovered = logFile.begin(path.c_str());
+        recovery_us = mock_now_us() - t0;
+        recovery_reads = sd->block_reads - reads0;
+        if (recovered) {
+            // what writeLogHeader() of a binary logger writes at boot
+            logHeaderRecord_t header;
+            header.tag.type = LOG_REC_HEADER;
+            header.tag.size = sizeof(header);
+            memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+            header.version = LOG_VERSION;
+            logFile.write((const uint8_t *)&header, sizeof(header));
+        }
+    }
+    // orderly stop : what is still buffered goes to the card, the file is closed
+    logFile.close();
+
+    const mock_serial_stats_t *ser = mock_serial_stats();
+    t_gpsStats gps_stats;
+    gps_get_stats(&gps_stats);
+    const mock_bmp085_stats_t *bmp = mock_bmp085_stats();
+    double loop_s = loop_ns / 1e9;
+
+    if (flood) {
+        printf("== bench_logger : %s x%u, flood ==\n", argv[optind], repeat);
+    } else {
+        printf("== bench_logger : %s x%u, %u Hz ==\n", argv[optind], repeat, rate_hz);
+    }
+    printf("virtual time        : %12.3f s\n", virtual_s);
+    const mock_gps_config_t *gps = mock_gps_config();
+    printf("gps baud            : %12lu\n", mock_serial_baud());
+    printf("gps module          : %12lu baud, %u ms, sentences 0x%02x, %u commands, %llu bytes garbled\n",
+           gps->baud, gps->interval_ms, gps->sentences, gps->commands,
+           (unsigned long long)ser->garbled);
+    printf("bytes delivered     : %12llu\n", (unsigned long long)ser->delivered);
+    printf("bytes dropped       : %12llu\n", (unsigned long long)ser->dropped + gps_stats.overruns);
+    printf("sentences sent      : %12llu\n", (unsigned long long)ser->lines_delivered);
+    printf("checksum errors     : %12u\n", gps_stats.checksumErrors);
+    printf("resyncs             : %12u\n", gps_stats.resyncs);
+    printf("records written     : %12llu (%.1f/s)\n", (unsigned long long)slots[PROFILE_WRITE_LOG].calls,
+           virtual_s > 0 ? slots[PROFILE_WRITE_LOG].calls / virtual_s : 0.0);
+    if (slots[PROFILE_WRITE_BARO].calls > 0) {
+        printf("baro records        : %12llu (%.1f/s)\n", (unsigned long long)slots[PROFILE_WRITE_BARO].calls,
+               virtual_s > 0 ? slots[PROFILE_WRITE_BARO].calls / virtual_s : 0.0);
+    }
+    printf("bmp085 cycles       : %12u (%.1f/s)\n", bmp->pressure_conversions,
+           virtual_s > 0 ? bmp->pressure_conversions / virtual_s : 0.0);
+    if (samples.count > 1) {
+        double n = (double)(samples.count - 1);
+        double mean = samples.interval_sum / n;
+        double var = samples.interval_sq_sum / n - mean * mean;
+        printf("bmp085 interval     : %12.3f ms mean, %.3f ms sd, %.3f ms max\n",
+               mean / 1e3, sqrt(var > 0 ? var : 0) / 1e3, samples.interval_max / 1e3);
+        printf("bmp085 stamp lag    : %12.3f ms mean, %.3f ms max (behind EOC)\n",
+               samples.lag_sum / samples.count / 1e3, samples.lag_max / 1e3);
+    }
+    printf("bmp085 idle         : %12.3f ms (%.1f%%)\n", bmp->idle_us / 1e3,
+           virtual_s > 0 ? bmp->idle_us / 1e4 / virtual_s : 0.0);
+    printf("bmp085 temperatures : %12u (%.1f/s)\n", bmp->temperature_conversions,
+           virtual_s > 0 ? bmp->temperature_conversions / virtual_s : 0.0);
+    printf("altitude noise      : %12.3f m per sample, %.3f m on 1 s means\n",
+           noise_sd(noise.diff_sum, noise.diff_sq_sum, noise.diffs),
+           noise_sd(noise.mean_diff_sum, noise.mean_diff_sq_sum, noise.mean_diffs));
+    if (fused.diffs > 0) {
+        double vz_mean = vspeed_sum / fused.reads;
+        double vz_var = vspeed_sq_sum / fused.reads - vz_mean * vz_mean;
+        printf("fused alt noise     : %12.3f m per sample, %.3f m on 1 s means\n",
+               noise_sd(fused.diff_sum, fused.diff_sq_sum, fused.diffs),
+               noise_sd(fused.mean_diff_sum, fused.mean_diff_sq_sum, fused.mean_diffs));
+        printf("vertical speed      : %12.3f m/s mean, %.3f m/s sd, hpa0 %ld Pa\n",
+               vz_mean, sqrt(vz_var > 0 ? vz_var : 0), (long)alt_fusion_sea_level_pa());
+    }
+    for (size_t i = 0; i < mock_sd_file_count(); i++) {
+        size_t segments;
+        std::vector<loggedAltitude_t> alts;
+        std::vector<uint8_t> stream = expand_deltas(log_stream(mock_sd_file_name(i), &segments));
+        logged_altitudes(stream.empty() ? NULL : &stream[0], stream.size(), &alts);
+        if (alts.size() > 1) {
+            double sum = 0, sq_sum = 0;
+            size_t diffs = 0;
+            for (size_t k = 1; k < alts.size(); k++) {
+                if (alts[k].hpa0 != alts[k - 1].hpa0) {
+                    continue;
+                }
+                double d = alts[k].alt - alts[k - 1].alt;
+                sum += d;
+                sq_sum += d * d;
+                diffs++;
+            }
+            printf("logged alt noise    : %12.3f m (%zu records, %zu hpa0 steps)\n",
+                   noise_sd(sum, sq_sum, diffs), alts.size(), alts.size() - 1 - diffs);
+            break;
+        }
+    }
+    if (pps) {
+        ppsErrors_t errors = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < mock_sd_file_count(); i++) {
+            size_t segments;
+            std::vector<uint8_t> stream = expand_deltas(log_stream(mock_sd_file_name(i), &segments));
+            pps_errors(stream.empty() ? NULL : &stream[0], stream.size(), start_us, utc0, clock_ppm, &errors);
+        }
+        printf("pps edges           : %12u, board clock %+d ppm\n", mock_pps_edges(), clock_ppm);
+        printf("pps utc error       : %12.3f ms mean, %.3f ms max (%llu of %llu baro records)\n",
+               errors.stamped ? errors.error_sum / errors.stamped / 1e3 : 0.0, errors.error_max / 1e3,
+               (unsigned long long)errors.stamped, (unsigned long long)errors.records);
+    }
+    printf("i2c bus             : %12u transactions, %.3f ms busy\n", bmp->i2c_transactions,
+           bmp->i2c_busy_us / 1e3);
+    printf("loop() passes       : %12llu\n", (unsigned long long)loops);
+    printf("host time in loop() : %12.3f ms\n", loop_s * 1e3);
+    printf("sentences/s (host)  : %12.0f\n", loop_s > 0 ? ser->lines_delivered / loop_s : 0.0);
+    printf("bytes/s (host)      : %12.0f\n", loop_s > 0 ? ser->delivered / loop_s : 0.0);
+    printf("worst loop() stall  : %12.3f ms (virtual)\n", worst_loop_us / 1e3);
+    printf("sd busy             : %12.3f ms, worst op %.3f ms, %u opens, %u block writes, %u multi-block\n",
+           sd->busy_us / 1e3, sd->max_op_us / 1e3, sd->opens, sd->block_writes, sd->stream_blocks);
+    size_t card_bytes = 0;
+    recordSizes_t sizes = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < mock_sd_file_count(); i++) {
+        size_t segments;
+        std::vector<uint8_t> stream = log_stream(mock_sd_file_name(i), &segments);
+        card_bytes += stream.size();
+        record_sizes(stream, &sizes);
+    }
+    printf("sd write rate       : %12.1f kB/s of busy time\n",
+           sd->busy_us > 0 ? card_bytes * 1e3 / sd->busy_us : 0.0);
+    printf("record size         : %12.1f bytes per GPS record, %.1f per baro record\n",
+           sizes.gps_records ? (double)sizes.gps_bytes / sizes.gps_records : 0.0,
+           sizes.baro_records ? (double)sizes.baro_bytes / sizes.baro_records : 0.0);
+    printf("card wear           : %12.0f blocks written per hour\n",
+           virtual_s > 0 ? (sd->block_writes + sd->stream_blocks) * 3600.0 / virtual_s : 0.0);
+    if (power_cut) {
+        printf("recovery            : %12.3f ms (virtual), %u block reads, %s\n", recovery_us / 1e3,
+               recovery_reads, recovered ? "resumed" : "failed");
+    }
+    printf("\n%-32s %10s %10s %10s %10s\n", "task (virtual time)", "runs", "misses", "deadline ms", "worst ms");
+    const schedTask_t *tasks[] = { &taskBmp, &taskGps, &taskRecord, &taskLog, &taskExtra };
+    const char *task_names[] = { "bmp085", "gps drain", "record", "log", "extra" };
+    for (int i = 0; i < 5; i++) {
+        if (tasks[i]->runs == 0 && tasks[i] == &taskExtra) {
+            continue;
+        }
+        printf("%-32s %10lu %10lu %10.3f %10.3f\n", task_names[i], (unsigned long)tasks[i]->runs,
+               (unsigned long)tasks[i]->misses,
+               tasks[i] == &taskExtra ? 0.0 : tasks[i]->deadlineUs / 1e3, tasks[i]->worstLateUs / 1e3);
+    }
+    printf("\n%-32s %10s %10s %10s %10s %10s\n", "call (host time)", "calls", "mean ns", "min ns", "max ns", "total ms");
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        profileSlot_t *s = &slots[i];
+        printf("%-32s %10llu %10.0f %10llu %10llu %10.3f\n", s->name,
+               (unsigned long long)s->calls,
+               s->calls ? (double)s->total_ns / s->calls : 0.0,
+               (unsigned long long)s->min_ns, (unsigned long long)s->max_ns,
+               s->total_ns / 1e6);
+    }
+
+    printf("\n");
+    for (size_t i = 0; i < mock_sd_file_count(); i++) {
+        size_t len;
+        const char *path = mock_sd_file_name(i);
+        size_t segments;
+        const uint8_t *data = mock_sd_file(path, &len);
+        size_t stream_len = log_stream(path, &segments).size();
+        printf("%-32s %10zu bytes, fnv1a %08x", path, len, fnv1a(data, len));
+        if (segments > 0) {
+            printf(", %zu log bytes in %zu segments", stream_len, segments);
+        }
+        printf("\n");
+    }
+    if (dump_dir && !mock_sd_dump(dump_dir)) {
+        fprintf(stderr, "cannot dump the card to %s\n", dump_dir);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Arduino.h (host mock)
+ *
+ *  Minimal stand-in for the Arduino core, so that the logger sources can be
+ *  built and run on a Linux box.
+ *
+ *  Time is virtual : millis()/micros() return the mock clock, which only
+ *  moves when the harness (or a mocked peripheral) advances it. See mock_hal.h.
+ *
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Print.h"
+
+/***************************************************
+* Types and constants
+***************************************************/
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define SS   10
+#define MOSI 11
+#define MISO 12
+#define SCK  13
+
+/***************************************************
+* Core functions
+***************************************************/
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void interrupts(void);
+void noInterrupts(void);
+
+void setup(void);
+void loop(void);
+
+/***************************************************
+* Serial
+***************************************************/
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud);
+    void end();
+    virtual int available(void);
+    virtual int peek(void);
+    virtual int read(void);
+    virtual void flush(void);
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* HOST_ARDUINO_H_ */
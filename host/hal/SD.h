@@ -0,0 +1,68 @@
+/*
+ * SD.h (host mock)
+ *
+ *  In-memory card with the Arduino SD library interface.
+ *  Card operations advance the virtual clock following a simple FAT latency
+ *  model (directory lookups, block writes, cluster allocation, dir entry
+ *  updates), see mock_sd_latency_t in mock_hal.h.
+ *
+ */
+
+#ifndef HOST_SD_H_
+#define HOST_SD_H_
+
+#include "Arduino.h"
+
+#define O_READ   0x01
+#define O_RDONLY O_READ
+#define O_WRITE  0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR   (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_SYNC   0x08
+#define O_CREAT  0x10
+#define O_EXCL   0x20
+#define O_TRUNC  0x40
+
+#define FILE_READ  O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT)
+
+struct MockFileHandle;
+
+class File : public Stream {
+private:
+    MockFileHandle *_handle;
+
+public:
+    File(void);
+    File(MockFileHandle *handle);
+
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buf, size_t size);
+    using Print::write;
+    virtual int read(void);
+    int read(void *buf, uint16_t nbyte);
+    virtual int peek(void);
+    virtual int available(void);
+    virtual void flush(void);
+    boolean seek(uint32_t pos);
+    uint32_t position(void);
+    uint32_t size(void);
+    void close(void);
+    const char *name(void);
+    operator bool();
+};
+
+class SDClass {
+public:
+    boolean begin(uint8_t csPin = SS);
+    File open(const char *filename, uint8_t mode = FILE_READ);
+    boolean exists(const char *filepath);
+    boolean mkdir(const char *filepath);
+    boolean remove(const char *filepath);
+    boolean rmdir(const char *filepath);
+};
+
+extern SDClass SD;
+
+#endif /* HOST_SD_H_ */
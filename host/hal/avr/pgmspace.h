@@ -0,0 +1,36 @@
+/*
+ * avr/pgmspace.h (host mock)
+ *
+ *  No separate program memory on the host : flash accessors are plain reads.
+ *  When the mock headers are reused for an AVR build (see avrbench/), the
+ *  real avr-libc header is used instead.
+ *
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#if defined(__AVR__)
+
+#include_next <avr/pgmspace.h>
+
+#else
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#define memcpy_P  memcpy
+#define strlen_P  strlen
+#define strcmp_P  strcmp
+#define strncmp_P strncmp
+
+#endif
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,664 @@
+/*
+ * mock_hal.cpp
+ *
+ *  Virtual clock, pins, GPS serial line and BMP085 behind the TWI.
+ *  See mock_hal.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "BMP085.h"
+#include "GPSMTK339.h"
+#include "GpsUart.h"
+#include "Pps.h"
+#include "Twi.h"
+#include "mock_hal.h"
+
+#define BMP085_ADDR 0x77
+#define I2C_BYTE_US 90  // 9 clocks at 100kHz
+#define I2C_START_STOP_US 10
+#define GPS_REPLY_US 2000 // PMTK001 after the end of the command
+#define PPS_PERIOD_US 1000000
+
+void mock_sd_reset(void); // mock_sd.cpp
+
+/***************************************************
+* DATA
+***************************************************/
+HardwareSerial Serial;
+
+static uint64_t now_us = 0;
+static int32_t clock_ppm = 0;
+
+static uint8_t pin_state[32];
+
+// GPS serial line
+typedef struct {
+    size_t first;          // index of the first byte of the burst
+    uint64_t not_before_ns;
+} burst_t;
+static std::vector<uint8_t> line_data;
+static std::vector<burst_t> line_bursts;
+static size_t line_next = 0;        // next byte to be delivered
+static size_t line_next_burst = 0;
+static uint64_t line_free_ns = 0;   // end of the last byte on the wire
+static unsigned long line_baud = 0;
+static bool line_flood = false;
+static bool line_to_uart = false; // bytes go to the GpsUart RX interrupt
+static uint64_t line_checked_us = ~0ULL; // clock at the last serial_deliver()
+static uint8_t rx_buf[MOCK_SERIAL_RX_BUFFER_SIZE];
+static uint8_t rx_head = 0;
+static uint8_t rx_count = 0;
+static mock_serial_stats_t serial_stats;
+static std::string tx_log;
+
+// GPS module : its settings, the command being received, its answers
+typedef struct {
+    std::string bytes;
+    uint64_t not_before_ns;
+} reply_t;
+static mock_gps_config_t gps_config;
+static std::string gps_command;
+static std::deque<reply_t> gps_replies;
+static size_t gps_reply_next = 0; // in the front reply
+
+// GPS PPS output
+static uint8_t pps_pin = 0xFF;          // pulsing
+static uint8_t pps_attached_pin = 0xFF; // the driver's interrupt
+static uint64_t pps_next_us = 0;
+static uint32_t pps_edges = 0;
+
+// BMP085
+static const int32_t default_ut[] = { 27898 };
+static const int32_t default_up19[] = { 23843 << 3 }; // datasheet example values
+static std::vector<int32_t> script_ut(default_ut, default_ut + 1);
+static std::vector<int32_t> script_up19(default_up19, default_up19 + 1);
+static size_t script_idx = 0;
+static uint8_t eoc_pin = 8;
+static uint8_t bmp_regs[256];
+static uint8_t bmp_pointer = 0;
+static uint64_t conversion_end_us = 0;
+static bool conversion_running = false; // EOC low, rising edge to come
+static bool eoc_attached = false;       // the BMP085 driver's EOC interrupt
+static mock_bmp085_stats_t bmp_stats;
+
+// TWI
+static twiTransaction_t *twi_active = NULL; // on the bus
+static uint64_t twi_end_us = 0;
+
+/***************************************************
+* Virtual clock
+***************************************************/
+static void bmp_reset(void);
+static void twi_complete(void);
+
+static void serial_push(uint8_t c) {
+    if (c == '\n') {
+        serial_stats.lines_delivered++;
+    }
+    if (line_baud != gps_config.baud) {
+        // framing errors at the receiver : noise
+        serial_stats.garbled++;
+        c = 0xFF;
+    }
+    if (line_to_uart) {
+        serial_stats.delivered++;
+        gps_uart_rx_byte(c);
+    } else if (rx_count < MOCK_SERIAL_RX_BUFFER_SIZE) {
+        rx_buf[(rx_head + rx_count) % MOCK_SERIAL_RX_BUFFER_SIZE] = c;
+        rx_count++;
+        serial_stats.delivered++;
+    } else {
+        serial_stats.dropped++;
+    }
+}
+
+// Start of the next stream byte on the wire, ~0 if none
+static uint64_t stream_next_ns(void) {
+    if (line_next >= line_data.size()) {
+        return ~0ULL;
+    }
+    uint64_t start = line_free_ns;
+    if (line_next_burst < line_bursts.size()
+            && line_bursts[line_next_burst].first == line_next
+            && line_bursts[line_next_burst].not_before_ns > start) {
+        start = line_bursts[line_next_burst].not_before_ns;
+    }
+    return start;
+}
+
+/*
+ * Bytes sent by the GPS until now, at the module baud. Its answers to the
+ * commands go between two lines of the stream.
+ */
+static void serial_deliver(void) {
+    if (line_flood || line_baud == 0 || line_checked_us == now_us) {
+        return;
+    }
+    line_checked_us = now_us;
+    uint64_t now_ns = now_us * 1000;
+    // 10 bits per byte : start, 8 data, stop
+    uint64_t byte_ns = 10000000000ULL / gps_config.baud;
+
+    for (;;) {
+        uint64_t stream = stream_next_ns();
+        bool boundary = line_next == 0 || line_data[line_next - 1] == '\n';
+
+        if (!gps_replies.empty() && (gps_reply_next > 0 || boundary)) {
+            uint64_t start = line_free_ns;
+            if (gps_reply_next == 0 && gps_replies.front().not_before_ns > start) {
+                start = gps_replies.front().not_before_ns;
+            }
+            if (gps_reply_next > 0 || start <= stream) {
+                if (start + byte_ns > now_ns) {
+                    break;
+                }
+                line_free_ns = start + byte_ns;
+                serial_push(gps_replies.front().bytes[gps_reply_next++]);
+                if (gps_reply_next == gps_replies.front().bytes.size()) {
+                    gps_replies.pop_front();
+                    gps_reply_next = 0;
+                }
+                continue;
+            }
+        }
+        if (stream == ~0ULL || stream + byte_ns > now_ns) {
+            break;
+        }
+        if (line_next_burst < line_bursts.size()
+                && line_bursts[line_next_burst].first == line_next) {
+            line_next_burst++;
+        }
+        line_free_ns = stream + byte_ns;
+        serial_push(line_data[line_next++]);
+    }
+}
+
+// In flood mode, the RX buffer is topped up each time the clock moves,
+// so that each loop() pass finds at most a full buffer.
+static void serial_flood(void) {
+    uint8_t budget = MOCK_SERIAL_RX_BUFFER_SIZE;
+    while (line_flood && line_next < line_data.size() && budget > 0
+            && rx_count < MOCK_SERIAL_RX_BUFFER_SIZE) {
+        serial_push(line_data[line_next++]);
+        budget--;
+    }
+}
+
+void mock_reset(void) {
+    now_us = 0;
+    clock_ppm = 0;
+    memset(pin_state, 0, sizeof(pin_state));
+
+    line_data.clear();
+    line_bursts.clear();
+    line_next = 0;
+    line_next_burst = 0;
+    line_free_ns = 0;
+    line_baud = 0;
+    line_flood = false;
+    line_to_uart = false;
+    line_checked_us = ~0ULL;
+    rx_head = 0;
+    rx_count = 0;
+    memset(&serial_stats, 0, sizeof(serial_stats));
+    tx_log.clear();
+    gps_config.baud = GPS_DEFAULT_BAUD;
+    gps_config.interval_ms = 1000;
+    gps_config.sentences = GPS_NMEA_GLL | GPS_NMEA_RMC | GPS_NMEA_VTG
+            | GPS_NMEA_GGA | GPS_NMEA_GSA | GPS_NMEA_GSV;
+    gps_config.commands = 0;
+    gps_command.clear();
+    gps_replies.clear();
+    gps_reply_next = 0;
+    pps_pin = 0xFF;
+    pps_attached_pin = 0xFF;
+    pps_edges = 0;
+
+    bmp_reset();
+    mock_sd_reset();
+}
+
+uint64_t mock_now_us(void) {
+    return now_us;
+}
+
+void mock_advance_us(uint64_t us) {
+    uint64_t target = now_us + us;
+
+    // interrupts on the way, in time order : they see their exact time
+    for (;;) {
+        bool eoc = conversion_running && conversion_end_us <= target;
+        bool twi = twi_active != NULL && twi_end_us <= target;
+        bool pps = pps_pin != 0xFF && pps_next_us <= target;
+
+        if (pps && (!eoc || pps_next_us <= conversion_end_us)
+                && (!twi || pps_next_us <= twi_end_us)) {
+            if (pps_next_us > now_us) {
+                now_us = pps_next_us;
+            }
+            pps_next_us += PPS_PERIOD_US;
+            pps_edges++;
+            if (pps_attached_pin == pps_pin) {
+                pps_edge();
+            }
+        } else if (eoc && (!twi || conversion_end_us <= twi_end_us)) {
+            if (conversion_end_us > now_us) {
+                now_us = conversion_end_us;
+            }
+            conversion_running = false;
+            if (eoc_attached) {
+                bmp085_eoc_rise();
+            }
+        } else if (twi) {
+            if (twi_end_us > now_us) {
+                now_us = twi_end_us;
+            }
+            twi_complete(); // may start the next transaction
+        } else {
+            break;
+        }
+    }
+    now_us = target;
+    serial_deliver();
+    serial_flood();
+}
+
+void mock_set_clock_ppm(int32_t ppm) {
+    clock_ppm = ppm;
+}
+
+uint64_t mock_board_us(uint64_t us) {
+    return us + (int64_t)us * clock_ppm / 1000000;
+}
+
+/***************************************************
+* Core functions
+***************************************************/
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin < sizeof(pin_state)) {
+        pin_state[pin] = val;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin == eoc_pin) {
+        return now_us >= conversion_end_us ? HIGH : LOW;
+    }
+    if (pin < sizeof(pin_state)) {
+        return pin_state[pin];
+    }
+    return LOW;
+}
+
+unsigned long millis(void) {
+    return (unsigned long)(uint32_t)(mock_board_us(now_us) / 1000);
+}
+
+unsigned long micros(void) {
+    return (unsigned long)(uint32_t)mock_board_us(now_us);
+}
+
+void delay(unsigned long ms) {
+    mock_advance_us((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    mock_advance_us(us);
+}
+
+void interrupts(void) {
+}
+
+void noInterrupts(void) {
+}
+
+/***************************************************
+* GPS serial line
+***************************************************/
+void HardwareSerial::begin(unsigned long baud) {
+    serial_deliver();
+    line_baud = baud;
+    line_checked_us = ~0ULL;
+}
+
+void HardwareSerial::end() {
+    line_baud = 0;
+}
+
+int HardwareSerial::available(void) {
+    serial_deliver();
+    return rx_count;
+}
+
+int HardwareSerial::peek(void) {
+    serial_deliver();
+    if (rx_count == 0) {
+        return -1;
+    }
+    return rx_buf[rx_head];
+}
+
+int HardwareSerial::read(void) {
+    serial_deliver();
+    if (rx_count == 0) {
+        return -1;
+    }
+    uint8_t c = rx_buf[rx_head];
+    rx_head = (rx_head + 1) % MOCK_SERIAL_RX_BUFFER_SIZE;
+    rx_count--;
+    return c;
+}
+
+void HardwareSerial::flush(void) {
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    tx_log.push_back((char)c);
+    return 1;
+}
+
+/*
+ * GpsUart hardware layer : the line feeds the RX interrupt directly.
+ */
+void gps_uart_hw_begin(unsigned long baud) {
+    serial_deliver();
+    line_baud = baud;
+    line_to_uart = true;
+    line_checked_us = ~0ULL;
+}
+
+/*
+ * A command line received by the GPS module : PMTK000 (test), PMTK220
+ * (interval), PMTK314 (output) are answered by PMTK001, PMTK251 switches
+ * the module speed without answer. The recorded stream does not change
+ * with the settings, they are only reported.
+ */
+static void gps_module_command(const std::string &line) {
+    size_t star = line.find('*');
+    if (line.compare(0, 5, "$PMTK") != 0 || star == std::string::npos || star + 3 > line.size()) {
+        return;
+    }
+    uint8_t sum = 0;
+    for (size_t i = 1; i < star; i++) {
+        sum ^= (uint8_t)line[i];
+    }
+    if (strtoul(line.substr(star + 1, 2).c_str(), NULL, 16) != sum) {
+        return; // dropped, as by the module
+    }
+    std::string body = line.substr(5, star - 5);
+    unsigned command = (unsigned)atoi(body.c_str());
+    size_t comma = body.find(',');
+    const char *params = comma == std::string::npos ? "" : body.c_str() + comma + 1;
+    unsigned flag = 3;
+
+    gps_config.commands++;
+    switch (command) {
+        case 0 :
+            break;
+        case 251 :
+            if (strtoul(params, NULL, 10) > 0) {
+                gps_config.baud = strtoul(params, NULL, 10);
+            }
+            return;
+        case 220 :
+            gps_config.interval_ms = (uint16_t)atoi(params);
+            break;
+        case 314 :
+            gps_config.sentences = 0;
+            for (int i = 0; i < 6 && *params; i++) {
+                if (*params != '0') {
+                    gps_config.sentences |= 1 << i;
+                }
+                while (*params && *params != ',') {
+                    params++;
+                }
+                if (*params == ',') {
+                    params++;
+                }
+            }
+            break;
+        default :
+            flag = 1; // unsupported
+            break;
+    }
+
+    char ack[32];
+    snprintf(ack, sizeof(ack), "PMTK001,%u,%u", command, flag);
+    sum = 0;
+    for (const char *p = ack; *p; p++) {
+        sum ^= (uint8_t)*p;
+    }
+    reply_t reply;
+    char text[48];
+    snprintf(text, sizeof(text), "$%s*%02X\r\n", ack, sum);
+    reply.bytes = text;
+    reply.not_before_ns = (now_us + GPS_REPLY_US) * 1000;
+    gps_replies.push_back(reply);
+    line_checked_us = ~0ULL;
+}
+
+/*
+ * Blocking, as the USART data register : the byte time at the line baud.
+ * The module only understands what is sent at its own speed.
+ */
+void gps_uart_hw_write(uint8_t c) {
+    tx_log.push_back((char)c);
+    if (line_baud > 0) {
+        mock_advance_us(10000000ULL / line_baud);
+    }
+    if (line_baud != gps_config.baud) {
+        gps_command.clear();
+        return;
+    }
+    if (c == '\n') {
+        gps_module_command(gps_command);
+        gps_command.clear();
+    } else if (c != '\r') {
+        gps_command.push_back((char)c);
+    }
+}
+
+void mock_serial_load(const uint8_t *data, size_t len, uint64_t at_us) {
+    burst_t burst;
+    serial_deliver();
+    burst.first = line_data.size();
+    burst.not_before_ns = at_us * 1000;
+    line_bursts.push_back(burst);
+    line_data.insert(line_data.end(), data, data + len);
+    line_checked_us = ~0ULL;
+    serial_flood();
+}
+
+void mock_serial_set_flood(bool flood) {
+    line_flood = flood;
+    serial_flood();
+}
+
+bool mock_serial_done(void) {
+    serial_deliver();
+    return line_next >= line_data.size() && rx_count == 0;
+}
+
+unsigned long mock_serial_baud(void) {
+    return line_baud;
+}
+
+const mock_serial_stats_t *mock_serial_stats(void) {
+    return &serial_stats;
+}
+
+const mock_gps_config_t *mock_gps_config(void) {
+    return &gps_config;
+}
+
+void mock_gps_set_baud(unsigned long baud) {
+    gps_config.baud = baud;
+}
+
+const char *mock_serial_tx(size_t *len) {
+    *len = tx_log.size();
+    return tx_log.c_str();
+}
+
+/***************************************************
+* GPS PPS
+***************************************************/
+void mock_pps_start(uint8_t pin, uint64_t first_us) {
+    pps_pin = pin;
+    pps_next_us = first_us;
+}
+
+uint32_t mock_pps_edges(void) {
+    return pps_edges;
+}
+
+// INT0 and INT1, as on the ATmega328
+boolean pps_hw_attach(uint8_t pin) {
+    pps_attached_pin = (pin == 2 || pin == 3) ? pin : 0xFF;
+    return pps_attached_pin != 0xFF;
+}
+
+/***************************************************
+* BMP085 model
+***************************************************/
+static void bmp_set16(uint8_t reg, uint16_t value) {
+    bmp_regs[reg] = value >> 8;
+    bmp_regs[reg + 1] = value & 0xFF;
+}
+
+static void bmp_reset(void) {
+    memset(bmp_regs, 0, sizeof(bmp_regs));
+    //Datasheet example calibration
+    bmp_set16(0xAA, (uint16_t)408);
+    bmp_set16(0xAC, (uint16_t)-72);
+    bmp_set16(0xAE, (uint16_t)-14383);
+    bmp_set16(0xB0, (uint16_t)32741);
+    bmp_set16(0xB2, (uint16_t)32757);
+    bmp_set16(0xB4, (uint16_t)23153);
+    bmp_set16(0xB6, (uint16_t)6190);
+    bmp_set16(0xB8, (uint16_t)4);
+    bmp_set16(0xBA, (uint16_t)-32768);
+    bmp_set16(0xBC, (uint16_t)-8711);
+    bmp_set16(0xBE, (uint16_t)2868);
+    bmp_regs[0xD0] = 0x55;
+
+    bmp_pointer = 0;
+    conversion_end_us = 0;
+    conversion_running = false;
+    eoc_attached = false;
+    twi_active = NULL;
+    script_idx = 0;
+    memset(&bmp_stats, 0, sizeof(bmp_stats));
+}
+
+static void bmp_start_conversion(uint8_t cmd) {
+    // conversion times, datasheet max values
+    static const uint32_t pressure_us[4] = { 4500, 7500, 13500, 25500 };
+    int32_t ut = script_ut[script_idx % script_ut.size()];
+    int32_t up19 = script_up19[script_idx % script_up19.size()];
+
+    if (bmp_stats.temperature_conversions > 0 && !conversion_running) {
+        bmp_stats.idle_us += now_us - conversion_end_us;
+    }
+
+    if (cmd == 0x2E) {
+        bmp_set16(0xF6, (uint16_t)ut);
+        bmp_regs[0xF8] = 0;
+        conversion_end_us = now_us + 4500;
+        conversion_running = true;
+        bmp_stats.temperature_conversions++;
+    } else if ((cmd & 0x3F) == 0x34) {
+        uint8_t oss = cmd >> 6;
+        uint32_t up24 = ((uint32_t)up19 >> (3 - oss)) << (8 - oss);
+        bmp_regs[0xF6] = (up24 >> 16) & 0xFF;
+        bmp_regs[0xF7] = (up24 >> 8) & 0xFF;
+        bmp_regs[0xF8] = up24 & 0xFF;
+        conversion_end_us = now_us + pressure_us[oss];
+        conversion_running = true;
+        bmp_stats.prev_pressure_end_us = bmp_stats.last_pressure_end_us;
+        bmp_stats.last_pressure_end_us = conversion_end_us;
+        bmp_stats.pressure_conversions++;
+        script_idx++;
+    }
+}
+
+void mock_bmp085_set_script(const int32_t *ut, const int32_t *up19, size_t count) {
+    script_ut.assign(ut, ut + count);
+    script_up19.assign(up19, up19 + count);
+    script_idx = 0;
+}
+
+void mock_bmp085_set_eoc_pin(uint8_t pin) {
+    eoc_pin = pin;
+}
+
+const mock_bmp085_stats_t *mock_bmp085_stats(void) {
+    return &bmp_stats;
+}
+
+boolean bmp085_eoc_hw_attach(uint8_t pin) {
+    eoc_attached = (pin == eoc_pin);
+    return eoc_attached;
+}
+
+/***************************************************
+* TWI
+***************************************************/
+// Registers written from the pointer, the first byte sent.
+static void bmp_write(const uint8_t *data, size_t len) {
+    if (len > 0) {
+        bmp_pointer = data[0];
+        if (len > 1 && bmp_pointer == 0xF4) {
+            bmp_start_conversion(data[1]);
+        }
+    }
+}
+
+static void bmp_read(uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        data[i] = bmp_regs[bmp_pointer++];
+    }
+}
+
+void twi_hw_begin(void) {
+    twi_active = NULL;
+}
+
+void twi_hw_start(twiTransaction_t *t) {
+    // address byte + payload, then address byte + data after a repeated start
+    size_t bytes = 1 + t->txLength;
+    if (t->rxLength > 0) {
+        bytes += 1 + t->rxLength;
+    }
+    uint64_t us = (uint64_t)bytes * I2C_BYTE_US + I2C_START_STOP_US;
+    bmp_stats.i2c_transactions++;
+    bmp_stats.i2c_busy_us += us;
+    twi_active = t;
+    twi_end_us = now_us + us;
+}
+
+static void twi_complete(void) {
+    twiTransaction_t *t = twi_active;
+
+    twi_active = NULL;
+    if (t->address != BMP085_ADDR) {
+        twi_hw_done(TWI_ERROR); // NACK on address
+        return;
+    }
+    bmp_write(t->txData, t->txLength);
+    bmp_read(t->rxData, t->rxLength);
+    twi_hw_done(TWI_OK);
+}
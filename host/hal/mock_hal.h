@@ -0,0 +1,148 @@
+/*
+ * mock_hal.h
+ *
+ *  Control side of the host mock HAL, used by the benchmark harnesses.
+ *
+ *  Everything runs on a virtual clock (micro seconds). The clock only moves
+ *  when it is advanced by the harness or by a mocked peripheral :
+ *   - the GPS serial line delivers the loaded NMEA bytes at the baud rate
+ *     of the GPS module, into a 64 bytes RX buffer like the core one
+ *     (overflowing bytes are dropped and counted), or to the GpsUart RX
+ *     interrupt once gps_uart_begin() has been called. Bytes received at
+ *     another baud than the module's arrive garbled,
+ *   - the GPS module answers the PMTK commands written to the line, the
+ *     bytes of a command taking their time at the line baud,
+ *   - TWI transactions complete, in the background, after their bus time
+     at 100kHz,
+ *   - the BMP085 model raises EOC once the conversion time has elapsed,
+ *     and runs the EOC interrupt of the driver at that exact time if it
+ *     was attached,
+ *   - SD card operations cost the time given by mock_sd_latency_t,
+ *   - the GPS PPS output pulses each second once started, running the PPS
+ *     interrupt if it was attached to its pin.
+ *  millis() and micros() follow the virtual clock, or a board clock off by
+ *  a few ppm from it (mock_set_clock_ppm()) : the virtual clock is UTC.
+ *
+ */
+
+#ifndef MOCK_HAL_H_
+#define MOCK_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MOCK_SERIAL_RX_BUFFER_SIZE 64
+
+/***************************************************
+* Virtual clock
+***************************************************/
+void mock_reset(void);
+uint64_t mock_now_us(void);
+void mock_advance_us(uint64_t us);
+// Board clock error : micros() = virtual time * (1 + ppm / 1e6).
+void mock_set_clock_ppm(int32_t ppm);
+// micros() of the board at a virtual time, not wrapped.
+uint64_t mock_board_us(uint64_t us);
+
+/***************************************************
+* GPS serial line
+***************************************************/
+typedef struct {
+    uint64_t delivered;       // bytes that reached the RX buffer or interrupt
+    uint64_t dropped;         // bytes lost on a full core RX buffer
+    uint64_t lines_delivered; // '\n' delivered
+    uint64_t garbled;         // received at another baud than the module's
+} mock_serial_stats_t;
+
+// GPS module settings, as set by the sketch commands.
+typedef struct {
+    unsigned long baud;   // PMTK251, 9600 at power on
+    uint16_t interval_ms; // PMTK220
+    uint8_t sentences;    // PMTK314, GPS_NMEA_* bits
+    uint32_t commands;    // PMTK commands understood
+} mock_gps_config_t;
+
+// Queues a burst of bytes sent by the GPS : its first byte is not sent
+// before at_us, then bytes follow each other at the Serial baud rate.
+void mock_serial_load(const uint8_t *data, size_t len, uint64_t at_us);
+// If true, the baud rate is ignored and the RX buffer is filled up each
+// time the clock moves (i.e. between two loop() passes).
+void mock_serial_set_flood(bool flood);
+// True once every loaded byte has been delivered (or dropped) and read.
+bool mock_serial_done(void);
+unsigned long mock_serial_baud(void);
+const mock_serial_stats_t *mock_serial_stats(void);
+// Everything the sketch wrote to Serial (PMTK commands...).
+const char *mock_serial_tx(size_t *len);
+const mock_gps_config_t *mock_gps_config(void);
+// Speed of the module at power on, e.g. left at another one by the last boot.
+void mock_gps_set_baud(unsigned long baud);
+
+// PPS rising edges on pin, every virtual second from first_us.
+void mock_pps_start(uint8_t pin, uint64_t first_us);
+uint32_t mock_pps_edges(void);
+
+/***************************************************
+* BMP085 model
+***************************************************/
+typedef struct {
+    uint32_t temperature_conversions;
+    uint32_t pressure_conversions;
+    uint32_t i2c_transactions;
+    uint64_t i2c_busy_us;
+    uint64_t idle_us;              // EOC high, next conversion not started
+    uint64_t last_pressure_end_us; // EOC time of the last pressure conversion
+    uint64_t prev_pressure_end_us; // and of the one before, if the last is running
+} mock_bmp085_stats_t;
+
+// Raw values returned by the successive conversions. Pressure is given at
+// ultra high resolution (19 bits), the model scales it to the requested
+// oversampling. The script loops when exhausted.
+void mock_bmp085_set_script(const int32_t *ut, const int32_t *up19, size_t count);
+void mock_bmp085_set_eoc_pin(uint8_t pin);
+const mock_bmp085_stats_t *mock_bmp085_stats(void);
+
+/***************************************************
+* SD card model
+***************************************************/
+typedef struct {
+    uint32_t open_us;         // directory lookup on open
+    uint32_t cluster_walk_us; // per cluster, seeking to the end of a file
+    uint32_t block_read_us;
+    uint32_t block_write_us;
+    uint32_t cluster_bytes;   // a FAT update happens at each new cluster
+    uint32_t spike_every;     // every N block writes, the card goes busy...
+    uint32_t spike_us;        // ...for that long (0 : never)
+    // multi-block writes (LOG_RAW) on pre-erased blocks : no busy spikes
+    uint32_t stream_start_us; // write command, with the pre-erase count
+    uint32_t stream_block_us; // per block : transfer and programming
+    uint32_t stream_stop_us;  // stop token and end of programming
+} mock_sd_latency_t;
+
+typedef struct {
+    uint32_t opens;
+    uint32_t closes;
+    uint32_t flushes;
+    uint32_t block_reads;
+    uint32_t block_writes;
+    uint32_t stream_blocks; // blocks of multi-block writes
+    uint64_t busy_us;   // total virtual time spent in card operations
+    uint32_t max_op_us; // longest single card operation
+} mock_sd_stats_t;
+
+mock_sd_latency_t *mock_sd_latency(void);
+const mock_sd_stats_t *mock_sd_stats(void);
+// Files of the card, by path order.
+size_t mock_sd_file_count(void);
+const char *mock_sd_file_name(size_t index);
+// Content of a file of the card, NULL if it does not exist.
+const uint8_t *mock_sd_file(const char *path, size_t *len);
+// Copies every file of the card under a host directory.
+bool mock_sd_dump(const char *host_dir);
+/*
+ * Power cut during the last block write of a LOG_RAW file : the second
+ * half of that block is lost, and the raw file layer is closed.
+ */
+void mock_sd_power_cut(void);
+
+#endif /* MOCK_HAL_H_ */
@@ -0,0 +1,653 @@
+/*
+ * mock_sd.cpp
+ *
+ *  In-memory SD card, with the Arduino SD library interface.
+ *
+ *  Latency model, in the spirit of the SdFat code behind the SD library :
+ *   - one 512 bytes block cache per open file,
+ *   - a block is written when the cache moves to another block or on flush,
+ *   - a partial block is read back before being modified,
+ *   - growing the file into a new cluster updates both FATs,
+ *   - flush (and close) rewrite the directory entry.
+ *  The raw block layer of LogFile (LOG_RAW) works on contiguous files of
+ *  their own block range (any FAT file is taken as contiguous, as SdFat
+ *  finds one written alone on a fresh card) : creating one writes its whole FAT chain and
+ *  erases it, the blocks are then read and written with no FAT cost,
+ *  multi-block writes cheaper per block and without spikes.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "LogFile.h"
+#include "SD.h"
+#include "mock_hal.h"
+
+#define BLOCK_SIZE 512
+
+/***************************************************
+* DATA
+***************************************************/
+SDClass SD;
+
+struct MockFile {
+    std::vector<uint8_t> data;
+};
+
+struct MockFileHandle {
+    std::string path;
+    MockFile *file;
+    uint32_t pos;
+    uint8_t mode;
+    int32_t cached_block;
+    bool dirty;
+    bool size_changed;
+};
+
+static std::map<std::string, MockFile> files;
+static std::set<std::string> dirs;
+
+static const mock_sd_latency_t default_latency = {
+    2500,  // open_us
+    20,    // cluster_walk_us
+    1200,  // block_read_us
+    2000,  // block_write_us
+    32768, // cluster_bytes
+    200,   // spike_every
+    40000, // spike_us
+    500,   // stream_start_us
+    800,   // stream_block_us
+    1000   // stream_stop_us
+};
+static mock_sd_latency_t latency = default_latency;
+static mock_sd_stats_t stats;
+
+// LOG_RAW files : their range of blocks
+struct RawExtent {
+    uint32_t first_block;
+    uint32_t blocks;
+};
+static std::map<std::string, RawExtent> extents;
+static uint32_t raw_next_block;
+// the one open, and the multi-block write going on
+struct RawFile {
+    std::string path;
+    RawExtent extent;
+    bool streaming;
+    uint32_t stream_block;
+    uint32_t stream_end;
+};
+static RawFile raw;
+static uint32_t raw_last_written; // card block, 0 : none
+#define RAW_FIRST_BLOCK 8192
+
+/***************************************************
+* Latency model
+***************************************************/
+static void card_busy(uint64_t us) {
+    stats.busy_us += us;
+    mock_advance_us(us);
+}
+
+static uint64_t block_read(void) {
+    stats.block_reads++;
+    return latency.block_read_us;
+}
+
+static uint64_t block_write(void) {
+    uint64_t us = latency.block_write_us;
+    stats.block_writes++;
+    if (latency.spike_every > 0 && stats.block_writes % latency.spike_every == 0) {
+        us += latency.spike_us;
+    }
+    return us;
+}
+
+static void end_op(uint64_t us) {
+    if (us > stats.max_op_us) {
+        stats.max_op_us = (uint32_t)us;
+    }
+    card_busy(us);
+}
+
+/***************************************************
+* Paths
+***************************************************/
+static std::string normalize(const char *path) {
+    std::string p;
+    while (*path == '/') {
+        path++;
+    }
+    for (; *path; path++) {
+        char c = *path;
+        if (c >= 'a' && c <= 'z') {
+            c = c - 'a' + 'A';
+        }
+        p.push_back(c);
+    }
+    while (!p.empty() && p[p.size() - 1] == '/') {
+        p.erase(p.size() - 1);
+    }
+    return p;
+}
+
+static bool parent_exists(const std::string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return true;
+    }
+    return dirs.count(path.substr(0, slash)) > 0;
+}
+
+/***************************************************
+* Control side
+***************************************************/
+void mock_sd_reset(void) {
+    files.clear();
+    dirs.clear();
+    latency = default_latency;
+    memset(&stats, 0, sizeof(stats));
+    extents.clear();
+    raw = RawFile();
+    raw_next_block = RAW_FIRST_BLOCK;
+    raw_last_written = 0;
+}
+
+mock_sd_latency_t *mock_sd_latency(void) {
+    return &latency;
+}
+
+const mock_sd_stats_t *mock_sd_stats(void) {
+    return &stats;
+}
+
+size_t mock_sd_file_count(void) {
+    return files.size();
+}
+
+const char *mock_sd_file_name(size_t index) {
+    std::map<std::string, MockFile>::iterator it = files.begin();
+    std::advance(it, index);
+    return it->first.c_str();
+}
+
+const uint8_t *mock_sd_file(const char *path, size_t *len) {
+    std::map<std::string, MockFile>::iterator it = files.find(normalize(path));
+    if (it == files.end()) {
+        return NULL;
+    }
+    *len = it->second.data.size();
+    return it->second.data.empty() ? (const uint8_t *)"" : &it->second.data[0];
+}
+
+bool mock_sd_dump(const char *host_dir) {
+    std::string root(host_dir);
+    if (mkdir(root.c_str(), 0777) != 0 && errno != EEXIST) {
+        return false;
+    }
+    for (std::set<std::string>::iterator d = dirs.begin(); d != dirs.end(); ++d) {
+        if (mkdir((root + "/" + *d).c_str(), 0777) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    for (std::map<std::string, MockFile>::iterator f = files.begin(); f != files.end(); ++f) {
+        FILE *out = fopen((root + "/" + f->first).c_str(), "wb");
+        if (out == NULL) {
+            return false;
+        }
+        if (!f->second.data.empty()) {
+            fwrite(&f->second.data[0], 1, f->second.data.size(), out);
+        }
+        fclose(out);
+    }
+    return true;
+}
+
+/***************************************************
+* SDClass
+***************************************************/
+boolean SDClass::begin(uint8_t csPin) {
+    (void)csPin;
+    card_busy(latency.block_read_us * 4); // MBR, boot sector, FAT, root
+    return true;
+}
+
+File SDClass::open(const char *filename, uint8_t mode) {
+    std::string path = normalize(filename);
+    uint64_t us = latency.open_us;
+
+    stats.opens++;
+    std::map<std::string, MockFile>::iterator it = files.find(path);
+    if (it == files.end()) {
+        if (!(mode & O_CREAT) || !parent_exists(path) || dirs.count(path)) {
+            end_op(us);
+            return File();
+        }
+        it = files.insert(std::make_pair(path, MockFile())).first;
+        us += block_write(); // new directory entry
+    }
+
+    MockFileHandle *h = new MockFileHandle;
+    h->path = path;
+    h->file = &it->second;
+    h->pos = 0;
+    h->mode = mode;
+    h->cached_block = -1;
+    h->dirty = false;
+    h->size_changed = false;
+
+    if (mode & O_TRUNC) {
+        it->second.data.clear();
+        h->size_changed = true;
+    }
+    if (mode & O_WRITE) {
+        // the SD library seeks to the end of the file, walking the cluster chain
+        h->pos = (uint32_t)it->second.data.size();
+        us += (uint64_t)(h->pos / latency.cluster_bytes) * latency.cluster_walk_us;
+    }
+    end_op(us);
+    return File(h);
+}
+
+boolean SDClass::exists(const char *filepath) {
+    std::string path = normalize(filepath);
+    card_busy(latency.open_us);
+    return files.count(path) > 0 || dirs.count(path) > 0;
+}
+
+boolean SDClass::mkdir(const char *filepath) {
+    std::string path = normalize(filepath);
+    std::string sub;
+    size_t start = 0;
+
+    // like the SD library, creates the intermediate directories
+    while (start <= path.size()) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string::npos) {
+            slash = path.size();
+        }
+        sub = path.substr(0, slash);
+        if (files.count(sub)) {
+            return false;
+        }
+        if (!dirs.count(sub)) {
+            dirs.insert(sub);
+            end_op(latency.open_us + 2 * block_write());
+        }
+        start = slash + 1;
+    }
+    return true;
+}
+
+boolean SDClass::remove(const char *filepath) {
+    std::string path = normalize(filepath);
+    if (!files.erase(path)) {
+        return false;
+    }
+    end_op(latency.open_us + 3 * block_write());
+    return true;
+}
+
+boolean SDClass::rmdir(const char *filepath) {
+    std::string path = normalize(filepath);
+    std::string prefix = path + "/";
+    for (std::map<std::string, MockFile>::iterator f = files.begin(); f != files.end(); ++f) {
+        if (f->first.compare(0, prefix.size(), prefix) == 0) {
+            return false;
+        }
+    }
+    if (!dirs.erase(path)) {
+        return false;
+    }
+    end_op(latency.open_us + block_write());
+    return true;
+}
+
+/***************************************************
+* File
+***************************************************/
+File::File(void) : _handle(NULL) {
+}
+
+File::File(MockFileHandle *handle) : _handle(handle) {
+}
+
+// Cost of moving the cache of h on the block holding pos, about to be modified.
+static uint64_t cache_block_for_write(MockFileHandle *h, uint32_t pos) {
+    uint64_t us = 0;
+    int32_t block = pos / BLOCK_SIZE;
+
+    if (block != h->cached_block) {
+        if (h->dirty) {
+            us += block_write();
+            h->dirty = false;
+        }
+        if (pos < h->file->data.size() || pos % BLOCK_SIZE != 0) {
+            us += block_read(); // partial block, read before modify
+        }
+        h->cached_block = block;
+    }
+    if (pos == h->file->data.size() && pos % latency.cluster_bytes == 0 && pos > 0) {
+        // new cluster : FAT block read, then both FAT copies written
+        us += block_read() + 2 * block_write();
+    }
+    return us;
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size) {
+    if (!_handle || !(_handle->mode & O_WRITE)) {
+        return 0;
+    }
+    MockFileHandle *h = _handle;
+    std::vector<uint8_t> &data = h->file->data;
+    uint64_t us = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        us += cache_block_for_write(h, h->pos);
+        if (h->pos < data.size()) {
+            data[h->pos] = buf[i];
+        } else {
+            data.push_back(buf[i]);
+            h->size_changed = true;
+        }
+        h->pos++;
+        h->dirty = true;
+    }
+    if (us) {
+        end_op(us);
+    }
+    return size;
+}
+
+int File::read(void) {
+    uint8_t c;
+    if (read(&c, 1) != 1) {
+        return -1;
+    }
+    return c;
+}
+
+int File::read(void *buf, uint16_t nbyte) {
+    if (!_handle || !(_handle->mode & O_READ)) {
+        return -1;
+    }
+    MockFileHandle *h = _handle;
+    std::vector<uint8_t> &data = h->file->data;
+    uint64_t us = 0;
+    uint16_t n = 0;
+
+    while (n < nbyte && h->pos < data.size()) {
+        int32_t block = h->pos / BLOCK_SIZE;
+        if (block != h->cached_block) {
+            if (h->dirty) {
+                us += block_write();
+                h->dirty = false;
+            }
+            us += block_read();
+            h->cached_block = block;
+        }
+        ((uint8_t *)buf)[n++] = data[h->pos++];
+    }
+    if (us) {
+        end_op(us);
+    }
+    return n;
+}
+
+int File::peek(void) {
+    if (!_handle || _handle->pos >= _handle->file->data.size()) {
+        return -1;
+    }
+    return _handle->file->data[_handle->pos];
+}
+
+int File::available(void) {
+    if (!_handle) {
+        return 0;
+    }
+    return (int)(_handle->file->data.size() - _handle->pos);
+}
+
+void File::flush(void) {
+    if (!_handle) {
+        return;
+    }
+    uint64_t us = 0;
+    stats.flushes++;
+    if (_handle->dirty) {
+        us += block_write();
+        _handle->dirty = false;
+    }
+    if (_handle->size_changed) {
+        us += block_read() + block_write(); // directory entry
+        _handle->size_changed = false;
+    }
+    if (us) {
+        end_op(us);
+    }
+}
+
+boolean File::seek(uint32_t pos) {
+    if (!_handle || pos > _handle->file->data.size()) {
+        return false;
+    }
+    _handle->pos = pos;
+    return true;
+}
+
+uint32_t File::position(void) {
+    return _handle ? _handle->pos : 0;
+}
+
+uint32_t File::size(void) {
+    return _handle ? (uint32_t)_handle->file->data.size() : 0;
+}
+
+void File::close(void) {
+    if (!_handle) {
+        return;
+    }
+    flush();
+    stats.closes++;
+    delete _handle;
+    _handle = NULL;
+}
+
+const char *File::name(void) {
+    if (!_handle) {
+        return "";
+    }
+    size_t slash = _handle->path.rfind('/');
+    return _handle->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+File::operator bool() {
+    return _handle != NULL;
+}
+
+/***************************************************
+* Raw blocks (LogFile.h, LOG_RAW)
+***************************************************/
+// Both FAT copies of the chain of clusters cluster0 to cluster1 (FAT32).
+static uint64_t fat_chain_write(uint32_t cluster0, uint32_t cluster1) {
+    uint64_t us = 0;
+    for (uint32_t b = cluster0 * 4 / BLOCK_SIZE; b <= cluster1 * 4 / BLOCK_SIZE; b++) {
+        us += block_read() + 2 * block_write();
+    }
+    return us;
+}
+
+// Data of a block of the open file, NULL out of its clusters or past its size.
+static uint8_t *raw_data(uint32_t block) {
+    std::map<std::string, MockFile>::iterator it = files.find(raw.path);
+    if (it == files.end() || block < raw.extent.first_block
+        || block >= raw.extent.first_block + raw.extent.blocks
+        || (size_t)(block - raw.extent.first_block + 1) * BLOCK_SIZE > it->second.data.size()) {
+        return NULL;
+    }
+    return &it->second.data[(size_t)(block - raw.extent.first_block) * BLOCK_SIZE];
+}
+
+static void raw_open(const std::string &path) {
+    raw = RawFile();
+    raw.path = path;
+    raw.extent = extents[path];
+}
+
+boolean log_raw_hw_begin(const char *filepath) {
+    // card and volume set up, root and folder opened
+    stats.opens++;
+    end_op(latency.open_us);
+    return parent_exists(normalize(filepath));
+}
+
+boolean log_raw_hw_create(const char *filepath, uint32_t size, uint32_t *firstBlock) {
+    std::string path = normalize(filepath);
+    uint64_t us = latency.open_us;
+    uint32_t clusters = (size + latency.cluster_bytes - 1) / latency.cluster_bytes;
+    RawExtent extent;
+
+    stats.opens++;
+    if (files.count(path) || dirs.count(path) || !parent_exists(path) || size == 0) {
+        end_op(us);
+        return false;
+    }
+    files[path].data.assign(size, 0); // erased
+    extent.first_block = raw_next_block;
+    extent.blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    extents[path] = extent;
+    raw_next_block += clusters * (latency.cluster_bytes / BLOCK_SIZE);
+    raw_open(path);
+    // chain, directory entry, then the erase command
+    us += fat_chain_write(0, clusters - 1) + 2 * block_write();
+    end_op(us);
+    *firstBlock = extent.first_block;
+    return true;
+}
+
+boolean log_raw_hw_open(const char *filepath, uint32_t *firstBlock, uint32_t *blocks) {
+    std::string path = normalize(filepath);
+
+    stats.opens++;
+    end_op(latency.open_us);
+    if (!files.count(path) || files[path].data.empty()) {
+        return false; // not there, or no cluster
+    }
+    if (!extents.count(path)) {
+        // a FAT file, taken as contiguous (as one written alone on a fresh
+        // card) : its whole clusters, like SdFile::contiguousRange()
+        uint32_t clusters = (files[path].data.size() + latency.cluster_bytes - 1) / latency.cluster_bytes;
+        RawExtent extent;
+        extent.first_block = raw_next_block;
+        extent.blocks = clusters * (latency.cluster_bytes / BLOCK_SIZE);
+        extents[path] = extent;
+        raw_next_block += extent.blocks;
+    }
+    raw_open(path);
+    *firstBlock = raw.extent.first_block;
+    *blocks = raw.extent.blocks;
+    return true;
+}
+
+void log_raw_hw_read_block(uint32_t block, uint8_t *data) {
+    uint8_t *src = raw_data(block);
+    if (raw.streaming || block < raw.extent.first_block
+        || block >= raw.extent.first_block + raw.extent.blocks) {
+        fprintf(stderr, "mock sd : bad block read on block %u\n", block);
+        abort();
+    }
+    if (src != NULL) {
+        memcpy(data, src, BLOCK_SIZE);
+    } else {
+        // past the size of a FAT file : the end of its last block and cluster
+        size_t at = (size_t)(block - raw.extent.first_block) * BLOCK_SIZE;
+        const std::vector<uint8_t> &file = files[raw.path].data;
+        size_t n = at < file.size() ? file.size() - at : 0;
+        memset(data, 0, BLOCK_SIZE);
+        if (n > 0) {
+            memcpy(data, &file[at], n);
+        }
+    }
+    end_op(block_read());
+}
+
+void log_raw_hw_write_start(uint32_t block, uint32_t count) {
+    if (raw.streaming || raw_data(block) == NULL) {
+        fprintf(stderr, "mock sd : bad multi-block write start on block %u\n", block);
+        abort();
+    }
+    raw.streaming = true;
+    raw.stream_block = block;
+    raw.stream_end = block + count;
+    end_op(latency.stream_start_us);
+}
+
+void log_raw_hw_write_data(const uint8_t *data) {
+    uint8_t *dst = raw_data(raw.stream_block);
+    if (!raw.streaming || dst == NULL || raw.stream_block >= raw.stream_end) {
+        fprintf(stderr, "mock sd : multi-block write out of its range\n");
+        abort();
+    }
+    memcpy(dst, data, BLOCK_SIZE);
+    raw_last_written = raw.stream_block;
+    raw.stream_block++;
+    stats.stream_blocks++;
+    end_op(latency.stream_block_us);
+}
+
+void log_raw_hw_write_stop(void) {
+    if (!raw.streaming) {
+        fprintf(stderr, "mock sd : multi-block write stop without a start\n");
+        abort();
+    }
+    raw.streaming = false;
+    end_op(latency.stream_stop_us);
+}
+
+void log_raw_hw_write_block(uint32_t block, const uint8_t *data) {
+    uint8_t *dst = raw_data(block);
+    if (raw.streaming || dst == NULL) {
+        fprintf(stderr, "mock sd : bad single block write on block %u\n", block);
+        abort();
+    }
+    memcpy(dst, data, BLOCK_SIZE);
+    raw_last_written = block;
+    end_op(block_write());
+}
+
+void log_raw_hw_close(void) {
+    if (raw.streaming) {
+        fprintf(stderr, "mock sd : raw file closed during a multi-block write\n");
+        abort();
+    }
+    stats.closes++;
+    raw = RawFile();
+}
+
+void mock_sd_power_cut(void) {
+    raw = RawFile();
+    if (raw_last_written == 0) {
+        return;
+    }
+    for (std::map<std::string, RawExtent>::iterator e = extents.begin(); e != extents.end(); ++e) {
+        if (raw_last_written >= e->second.first_block
+            && raw_last_written < e->second.first_block + e->second.blocks) {
+            std::vector<uint8_t> &data = files[e->first].data;
+            size_t at = (size_t)(raw_last_written - e->second.first_block) * BLOCK_SIZE;
+            memset(&data[at + BLOCK_SIZE / 2], 0xA5, BLOCK_SIZE / 2);
+        }
+    }
+    raw_last_written = 0;
+}
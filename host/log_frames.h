@@ -0,0 +1,48 @@
+/*
+ * log_frames.h
+ *
+ *  Host side of LogFrame.h : the log stream of a LOG_RAW file, read back
+ *  from its valid frames. It comes in segments, a new one at each
+ *  LOG_FRAME_RESTART frame : a segment may end inside a record (cut by a
+ *  power loss), the next one starts on a record.
+ *
+ */
+
+#ifndef HOST_LOG_FRAMES_H_
+#define HOST_LOG_FRAMES_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "LogFrame.h"
+
+typedef std::vector<std::vector<uint8_t> > logSegments_t;
+
+/*
+ * Segments of the framed file data, to *segments. False if data does not
+ * start with a valid frame.
+ */
+static inline bool log_frames_unpack(const uint8_t *data, size_t len, logSegments_t *segments) {
+    uint32_t seq;
+
+    segments->clear();
+    for (seq = 0; (size_t)(seq + 1) * LOG_FRAME_SIZE <= len; seq++) {
+        const uint8_t *frame = data + (size_t)seq * LOG_FRAME_SIZE;
+        logFrameHeader_t header;
+
+        if (!log_frame_valid(frame, seq)) {
+            break;
+        }
+        memcpy(&header, frame, sizeof(header));
+        if (seq == 0 || (header.flags & LOG_FRAME_RESTART)) {
+            segments->push_back(std::vector<uint8_t>());
+        }
+        segments->back().insert(segments->back().end(), frame + sizeof(header),
+                                frame + sizeof(header) + header.length);
+    }
+    return seq > 0;
+}
+
+#endif /* HOST_LOG_FRAMES_H_ */
@@ -0,0 +1,286 @@
+/*
+ * logdecode.cpp
+ *
+ *  Converts a binary log (LOG_BINARY build, see LogRecord.h) to CSV on
+ *  stdout, rendered by the code of the CSV mode of the logger (LogFormat.h).
+ *
+ *  A column line is printed for each header record, i.e. each boot.
+ *  Unknown record types are skipped. Older GPS records get 0 in the
+ *  columns of the fields appended since. Baro records are printed as the
+ *  "B|us|hpa|utc|" lines of the CSV mode, where they come.
+ *
+ *  With -m, only the baro records are printed, merged on the UTC time
+ *  base of the GPS records : each one gets the date and time of the
+ *  closest previous GPS record of its session (the next one before the
+ *  first), moved by the micros() difference, and its altitude for the
+ *  hpa0 of that record. The time of a record stamped by the PPS (utc_dms)
+ *  is taken as is instead, the pps column telling which one was used.
+ *  A truncated or inconsistent record
+ *  stops the decoding with a message on stderr (exit code 1), the records
+ *  before it being printed.
+ *
+ *  Delta records (LOG_DELTA, LogDelta.h) are printed as the full ones.
+ *
+ *  Files of a LOG_RAW logger are made of frames (LogFrame.h) : their log
+ *  stream is read back from the valid ones, segment by segment. A record
+ *  cut at the end of a segment by a power loss is reported and skipped.
+ *  With -r, the stream is printed as it is (CSV LOG_RAW logs).
+ *
+ *  usage : logdecode [-m | -r] <binary log>
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "BaroAltitude.h"
+#include "LogDelta.h"
+#include "LogFormat.h"
+#include "LogRecord.h"
+#include "log_frames.h"
+
+/***************************************************
+* Input
+***************************************************/
+static bool load_file(const char *path, std::vector<uint8_t> *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        out->insert(out->end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+/***************************************************
+* Merged baro output (-m)
+***************************************************/
+typedef struct {
+    uint32_t micros;
+    uint8_t year, month, day;
+    double seconds;   // of the day
+    int32_t hpa0_pa;
+} anchor_t;
+
+typedef struct {
+    logBaroRecord_t record;
+    size_t anchors_before; // in the file
+} baro_t;
+
+// one session : from a header record to the next one
+static std::vector<anchor_t> anchors;
+static std::vector<baro_t> baros;
+
+static void add_anchor(const logGpsRecord_t *record) {
+    anchor_t a;
+
+    if (record->year == 0 && record->month == 0 && record->day == 0) {
+        return; // no time yet
+    }
+    a.micros = record->micros;
+    a.year = record->year;
+    a.month = record->month;
+    a.day = record->day;
+    a.seconds = record->hour * 3600.0 + record->minute * 60.0 + record->seconds
+            + record->milliseconds / 1000.0;
+    a.hpa0_pa = record->hpa0_pa;
+    anchors.push_back(a);
+}
+
+static void flush_session(void) {
+    int32_t reference = 0;
+
+    if (!baros.empty() && anchors.empty()) {
+        fprintf(stderr, "%zu baro records without GPS time skipped\n", baros.size());
+    }
+    for (size_t i = 0; i < baros.size() && !anchors.empty(); i++) {
+        const logBaroRecord_t *b = &baros[i].record;
+        // micros() wraps : the order comes from the file, not from the values
+        size_t before = baros[i].anchors_before;
+        const anchor_t *a = &anchors[before > 0 ? before - 1 : 0];
+        bool pps = b->utc_dms != LOG_NO_UTC;
+        double t = a->seconds + (int32_t)(b->micros - a->micros) / 1e6;
+        if (pps) {
+            t = b->utc_dms / 1e4;
+            if (t < a->seconds - 43200) {
+                t += 86400; // past midnight, on the date of the record
+            }
+        }
+        long dms = lround(t * 10000);
+
+        if (a->hpa0_pa != reference) {
+            reference = a->hpa0_pa;
+            baro_altitude_reference(reference);
+        }
+        printf("20%02u%02u%02u|%02ld%02ld%02ld.%04ld|%ld|%.2f|%d|\n", a->year, a->month, a->day,
+               dms / 36000000, dms / 600000 % 60, dms / 10000 % 60, dms % 10000,
+               (long)b->pressure_pa, baro_altitude_cm(b->pressure_pa) / 100.0, pps);
+    }
+    anchors.clear();
+    baros.clear();
+}
+
+/***************************************************
+* Decoding
+***************************************************/
+/*
+ * Prints the records of log : 0, or 1 on a bad record. With cut, log may
+ * end inside a record.
+ */
+static int decode(const char *name, const std::vector<uint8_t> &log, bool merge, bool cut) {
+    logDeltaState_t deltas;
+    size_t pos = 0;
+
+    log_delta_reset(&deltas);
+    while (pos < log.size()) {
+        logRecordTag_t tag;
+        uint8_t full[LOG_DELTA_FULL_MAX];
+        bool truncated = log.size() - pos < sizeof(tag);
+        if (!truncated) {
+            memcpy(&tag, &log[pos], sizeof(tag));
+            truncated = tag.size >= sizeof(tag) && log.size() - pos < tag.size;
+        }
+        if (truncated && cut) {
+            fprintf(stderr, "%s : record cut by a power loss at %zu, skipped\n", name, pos);
+            break;
+        }
+        if (truncated || tag.size < sizeof(tag)) {
+            fprintf(stderr, "%s : bad or truncated record at %zu\n", name, pos);
+            return 1;
+        }
+        if (pos == 0 && tag.type != LOG_REC_HEADER) {
+            fprintf(stderr, "%s : not a binary log\n", name);
+            return 1;
+        }
+
+        // delta records as the full ones
+        if (log_delta_decode(&deltas, &log[pos], full) == 0) {
+            fprintf(stderr, "%s : delta record without its keyframe at %zu\n", name, pos);
+            return 1;
+        }
+        uint8_t size = full[1];
+
+        switch (full[0]) {
+            case LOG_REC_HEADER: {
+                logHeaderRecord_t header;
+                if (size < sizeof(header)) {
+                    fprintf(stderr, "%s : short header at %zu\n", name, pos);
+                    return 1;
+                }
+                memcpy(&header, full, sizeof(header));
+                if (memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0) {
+                    fprintf(stderr, "%s : not a binary log (at %zu)\n", name, pos);
+                    return 1;
+                }
+                if (header.version > LOG_VERSION) {
+                    fprintf(stderr, "%s : version %u, newer fields ignored\n", name, header.version);
+                }
+                if (merge) {
+                    flush_session();
+                    printf("Date|Time|hpa|alt|pps|\n");
+                } else {
+                    printf("%s\n", logTextColumns);
+                }
+                break;
+            }
+            case LOG_REC_GPS: {
+                logGpsRecord_t record;
+                char line[LOG_TEXT_MAX];
+                if (size < LOG_GPS_RECORD_V1_SIZE) {
+                    fprintf(stderr, "%s : short GPS record at %zu\n", name, pos);
+                    return 1;
+                }
+                // fields of a later version than the record's stay 0
+                memset(&record, 0, sizeof(record));
+                memcpy(&record, full, size < sizeof(record) ? size : sizeof(record));
+                if (merge) {
+                    if (size >= sizeof(record)) { // with micros
+                        add_anchor(&record);
+                    }
+                    break;
+                }
+                uint8_t len = log_format_gps(line, &record);
+                fwrite(line, 1, len - 2, stdout); // without the CR
+                putchar('\n');
+                break;
+            }
+            case LOG_REC_BARO: {
+                baro_t baro;
+                char line[LOG_TEXT_MAX];
+                if (size < LOG_BARO_RECORD_V3_SIZE) {
+                    fprintf(stderr, "%s : short baro record at %zu\n", name, pos);
+                    return 1;
+                }
+                baro.record.utc_dms = LOG_NO_UTC; // version 3
+                memcpy(&baro.record, full, size < sizeof(baro.record) ? size : sizeof(baro.record));
+                if (merge) {
+                    baro.anchors_before = anchors.size();
+                    baros.push_back(baro);
+                    break;
+                }
+                uint8_t len = log_format_baro(line, &baro.record);
+                fwrite(line, 1, len - 2, stdout);
+                putchar('\n');
+                break;
+            }
+            default:
+                break;
+        }
+        pos += tag.size;
+    }
+    return 0;
+}
+
+/***************************************************
+* Main
+***************************************************/
+int main(int argc, char **argv) {
+    std::vector<uint8_t> log;
+    logSegments_t segments;
+    bool merge = false;
+    bool raw = false;
+    int status = 0;
+
+    if (argc == 3 && strcmp(argv[1], "-m") == 0) {
+        merge = true;
+        argv++;
+        argc--;
+    } else if (argc == 3 && strcmp(argv[1], "-r") == 0) {
+        raw = true;
+        argv++;
+        argc--;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage : %s [-m | -r] <binary log>\n", argv[0]);
+        return 2;
+    }
+    if (!load_file(argv[1], &log)) {
+        fprintf(stderr, "%s : can't read\n", argv[1]);
+        return 2;
+    }
+
+    if (!log_frames_unpack(log.empty() ? NULL : &log[0], log.size(), &segments)) {
+        segments.assign(1, log);
+    }
+    for (size_t i = 0; i < segments.size() && status == 0; i++) {
+        if (raw) {
+            if (!segments[i].empty()) {
+                fwrite(&segments[i][0], 1, segments[i].size(), stdout);
+            }
+        } else {
+            status = decode(argv[1], segments[i], merge, i + 1 < segments.size());
+        }
+    }
+    if (merge) {
+        flush_session();
+    }
+    return status;
+}
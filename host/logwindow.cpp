@@ -0,0 +1,273 @@
+/*
+ * logwindow.cpp
+ *
+ *  Extracts a UTC time window from a session file of the logger (CSV or
+ *  binary, see LogSession.h) without reading it from the start : the
+ *  time index next to it (same name, .IDX) is binary searched for the
+ *  last indexed GPS record at or before the start, and the file is read
+ *  from its offset only.
+ *
+ *  The window runs from the first GPS record at or after start to the
+ *  first one after end (excluded), with the baro records between. It is
+ *  written on stdout in the format of the file : its first line (the CSV
+ *  columns) or its header record first, so a binary window goes to
+ *  logdecode like a whole log (delta records expanded, see LogDelta.h) :
+ *
+ *      logwindow 104207.BIN 104500 105500 > window.bin
+ *      logdecode window.bin
+ *
+ *  Without the index, or with offsets past the end of the data (power
+ *  cut), the file is read from the start. The bytes read, and the index
+ *  lines read, are printed on stderr.
+ *
+ *  usage : logwindow <session file> <start HHMMSS> <end HHMMSS>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "LogDelta.h"
+#include "LogRecord.h"
+#include "LogSession.h"
+
+/***************************************************
+* Input
+***************************************************/
+static size_t bytes_read = 0;
+
+static bool read_at(FILE *f, long offset, void *buf, size_t len) {
+    if (fseek(f, offset, SEEK_SET) != 0 || fread(buf, 1, len, f) != len) {
+        return false;
+    }
+    bytes_read += len;
+    return true;
+}
+
+// HHMMSS to seconds of the day, -1 if it is not one
+static long parse_time(const char *text, size_t len) {
+    long hms = 0;
+
+    if (len < 6) {
+        return -1;
+    }
+    for (size_t i = 0; i < 6; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return -1;
+        }
+        hms = hms * 10 + text[i] - '0';
+    }
+    return hms / 10000 * 3600 + hms / 100 % 100 * 60 + hms % 100;
+}
+
+/***************************************************
+* Time index
+***************************************************/
+/*
+ * Offset of the last indexed record at or before start, 0 if none (or no
+ * index). *lines : the index lines read.
+ */
+static long seek_offset(const char *path, long start, long file_size, unsigned *lines) {
+    std::string index(path);
+    size_t dot = index.rfind('.');
+    char line[LOG_TIME_INDEX_LINE];
+    long offset = 0;
+
+    *lines = 0;
+    index = index.substr(0, dot == std::string::npos ? index.size() : dot) + "." LOG_TIME_INDEX_EXTENSION;
+    FILE *f = fopen(index.c_str(), "rb");
+    if (f == NULL) {
+        fprintf(stderr, "%s : no time index, read from the start\n", path);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long low = 0, high = ftell(f) / LOG_TIME_INDEX_LINE; // lines [low, high) unknown
+    while (low < high) {
+        long middle = (low + high) / 2;
+        (*lines)++;
+        if (fseek(f, middle * LOG_TIME_INDEX_LINE, SEEK_SET) != 0
+                || fread(line, 1, sizeof(line), f) != sizeof(line) || parse_time(line, 6) < 0) {
+            fprintf(stderr, "%s : bad line %ld, read from the start\n", index.c_str(), middle);
+            offset = 0;
+            break;
+        }
+        if (parse_time(line, 6) <= start) {
+            offset = atol(&line[7]);
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    fclose(f);
+    if (offset > file_size) {
+        fprintf(stderr, "%s : offset past the data, read from the start\n", index.c_str());
+        offset = 0;
+    }
+    return offset;
+}
+
+/***************************************************
+* Windows
+***************************************************/
+// GPS record in the window : 1, before it : 0, after it : -1
+static int place(long time, long start, long end, bool *started) {
+    if (time > end) {
+        return -1;
+    }
+    if (time >= start) {
+        *started = true;
+    }
+    return *started ? 1 : 0;
+}
+
+/*
+ * CSV : the column line, then the lines of the window. The Time column
+ * of a GPS line is its 6th one.
+ */
+static int csv_window(FILE *f, long offset, long size, long start, long end) {
+    std::string line;
+    bool columns = true;
+    bool started = false;
+    long pos = 0;
+
+    while (pos < size) {
+        char chunk[4096];
+        size_t n = (size_t)(size - pos) < sizeof(chunk) ? (size_t)(size - pos) : sizeof(chunk);
+        if (!read_at(f, pos, chunk, n)) {
+            return 1;
+        }
+        pos += n;
+        for (size_t i = 0; i < n; i++) {
+            line.push_back(chunk[i]);
+            if (chunk[i] != '\n') {
+                continue;
+            }
+            if (columns) {
+                fwrite(line.data(), 1, line.size(), stdout);
+                columns = false;
+                line.clear();
+                if (offset > 0) {
+                    pos = offset;
+                    break;
+                }
+                continue;
+            }
+            int in = started ? 1 : 0;
+            if (line.compare(0, 2, "B|") != 0) {
+                size_t field = 0;
+                for (int k = 0; k < 5 && field != std::string::npos; k++) {
+                    field = line.find('|', field);
+                    if (field != std::string::npos) {
+                        field++;
+                    }
+                }
+                long time = field == std::string::npos ? -1 : parse_time(&line[field], line.size() - field);
+                if (time >= 0) {
+                    in = place(time, start, end, &started);
+                }
+            }
+            if (in < 0) {
+                return 0;
+            }
+            if (in > 0) {
+                fwrite(line.data(), 1, line.size(), stdout);
+            }
+            line.clear();
+        }
+    }
+    return 0;
+}
+
+/*
+ * Binary : the header record, then the records of the window, delta
+ * records written as the full ones (the window may start after their
+ * keyframe).
+ */
+static int binary_window(FILE *f, const char *path, long offset, long size, long start, long end) {
+    logRecordTag_t tag;
+    std::vector<uint8_t> record;
+    logDeltaState_t deltas;
+    uint8_t full[LOG_DELTA_FULL_MAX];
+    bool started = false;
+    long pos = 0;
+
+    log_delta_reset(&deltas);
+
+    while (pos + (long)sizeof(tag) <= size) {
+        if (!read_at(f, pos, &tag, sizeof(tag)) || tag.size < sizeof(tag) || pos + tag.size > size) {
+            break; // a record cut by a power loss
+        }
+        record.resize(tag.size);
+        memcpy(&record[0], &tag, sizeof(tag));
+        if (!read_at(f, pos + sizeof(tag), &record[sizeof(tag)], tag.size - sizeof(tag))) {
+            return 1;
+        }
+        if (pos == 0) {
+            if (tag.type != LOG_REC_HEADER) {
+                fprintf(stderr, "%s : not a binary log\n", path);
+                return 1;
+            }
+            fwrite(&record[0], 1, record.size(), stdout);
+            pos = offset > 0 ? offset : pos + tag.size;
+            continue;
+        }
+        uint8_t full_size = log_delta_decode(&deltas, &record[0], full);
+        if (full_size == 0) {
+            fprintf(stderr, "%s : delta record without its keyframe at %ld\n", path, pos);
+            return 1;
+        }
+        int in = started ? 1 : 0;
+        if (full[0] == LOG_REC_GPS && full_size >= LOG_GPS_RECORD_V1_SIZE) {
+            logGpsRecord_t gps;
+            memset(&gps, 0, sizeof(gps));
+            memcpy(&gps, full, full_size < sizeof(gps) ? full_size : sizeof(gps));
+            in = place((long)gps.hour * 3600 + gps.minute * 60 + gps.seconds, start, end, &started);
+        }
+        if (in < 0) {
+            break;
+        }
+        if (in > 0) {
+            fwrite(full, 1, full_size, stdout);
+        }
+        pos += tag.size;
+    }
+    return 0;
+}
+
+/***************************************************
+* Main
+***************************************************/
+int main(int argc, char **argv) {
+    long start, end;
+    unsigned lines;
+    uint8_t first;
+    int status;
+
+    if (argc != 4 || (start = parse_time(argv[2], strlen(argv[2]))) < 0
+            || (end = parse_time(argv[3], strlen(argv[3]))) < 0) {
+        fprintf(stderr, "usage : %s <session file> <start HHMMSS> <end HHMMSS>\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        fprintf(stderr, "%s : can't read\n", argv[1]);
+        return 2;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    long offset = seek_offset(argv[1], start, size, &lines);
+
+    if (size > 0 && read_at(f, 0, &first, 1) && first == LOG_REC_HEADER) {
+        status = binary_window(f, argv[1], offset, size, start, end);
+    } else {
+        status = csv_window(f, offset, size, start, end);
+    }
+    fclose(f);
+    fprintf(stderr, "%s : %zu of %ld bytes read from offset %ld, %u index lines\n",
+            argv[1], bytes_read, size, offset, lines);
+    return status;
+}